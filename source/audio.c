@@ -0,0 +1,211 @@
+/* 
+ * Copyright (c) 2015-2025, Extrems' Corner.org
+ * 
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <asndlib.h>
+#include <gccore.h>
+#include "audio.h"
+
+#define AUDIO_RING_MASK (AUDIO_RING_SAMPLES - 1)
+#define AUDIO_TARGET    (AUDIO_BLOCK_SAMPLES * 4)
+
+#define RESAMPLE_TAPS       8
+#define RESAMPLE_PHASE_BITS 6
+#define RESAMPLE_PHASES     (1 << RESAMPLE_PHASE_BITS)
+#define RESAMPLE_INPUT      1024
+
+static uint32_t ring[AUDIO_RING_SAMPLES] ATTRIBUTE_ALIGN(32);
+static volatile uint32_t ring_read, ring_write;
+static volatile bool playing;
+
+static int16_t coef[RESAMPLE_PHASES][RESAMPLE_TAPS];
+static int16_t history[RESAMPLE_TAPS + RESAMPLE_INPUT][2];
+static size_t history_len;
+static uint32_t position;
+static uint32_t step;
+static unsigned input_rate, output_rate;
+
+audio_stats_t audio_stats;
+
+static void voice_cb(s32 voice)
+{
+	uint32_t read = ring_read;
+
+	if (!playing)
+		return;
+
+	if (ring_write - read >= AUDIO_BLOCK_SAMPLES) {
+		ASND_AddVoice(voice, &ring[read & AUDIO_RING_MASK], AUDIO_BLOCK_SAMPLES * sizeof(*ring));
+		ring_read = read + AUDIO_BLOCK_SAMPLES;
+	} else {
+		audio_stats.underruns++;
+		playing = false;
+	}
+}
+
+static void start_voice(void)
+{
+	uint32_t read = ring_read;
+	void *block = &ring[read & AUDIO_RING_MASK];
+
+	ring_read = read + AUDIO_BLOCK_SAMPLES;
+
+	if (ASND_AddVoice(0, block, AUDIO_BLOCK_SAMPLES * sizeof(*ring)) != SND_OK)
+		ASND_SetVoice(0, VOICE_STEREO_16BIT, output_rate, 0, block, AUDIO_BLOCK_SAMPLES * sizeof(*ring), MAX_VOLUME, MAX_VOLUME, voice_cb);
+
+	playing = true;
+}
+
+static uint32_t *reserve(size_t *count)
+{
+	uint32_t write = ring_write;
+	size_t used = write - ring_read + AUDIO_BLOCK_SAMPLES * 2;
+	size_t contiguous = AUDIO_RING_SAMPLES - (write & AUDIO_RING_MASK);
+
+	*count = used < AUDIO_RING_SAMPLES ? AUDIO_RING_SAMPLES - used : 0;
+	if (*count > contiguous) *count = contiguous;
+
+	return &ring[write & AUDIO_RING_MASK];
+}
+
+static void commit(size_t count)
+{
+	uint32_t write = ring_write;
+
+	DCStoreRange(&ring[write & AUDIO_RING_MASK], count * sizeof(*ring));
+	ring_write = write + count;
+
+	if (!playing && AudioLevel() >= AUDIO_BLOCK_SAMPLES * 2)
+		start_voice();
+}
+
+static void fill_coef(void)
+{
+	double cutoff = input_rate > output_rate ? .9 * output_rate / input_rate : .9;
+
+	for (int phase = 0; phase < RESAMPLE_PHASES; phase++) {
+		double weight[RESAMPLE_TAPS], sum = 0.;
+		int total = 0;
+
+		for (int tap = 0; tap < RESAMPLE_TAPS; tap++) {
+			double x = tap - (RESAMPLE_TAPS / 2 - 1) - (double)phase / RESAMPLE_PHASES;
+			double w = .42 + .5 * cos(M_PI * x / (RESAMPLE_TAPS / 2)) + .08 * cos(2. * M_PI * x / (RESAMPLE_TAPS / 2));
+
+			weight[tap] = (x == 0. ? cutoff : sin(M_PI * cutoff * x) / (M_PI * x)) * w;
+			sum += weight[tap];
+		}
+
+		for (int tap = 0; tap < RESAMPLE_TAPS; tap++) {
+			coef[phase][tap] = lrint(weight[tap] / sum * (1 << 14));
+			total += coef[phase][tap];
+		}
+
+		coef[phase][RESAMPLE_TAPS / 2 - 1] += (1 << 14) - total;
+	}
+}
+
+static inline int16_t clamp16(int32_t value)
+{
+	return value < INT16_MIN ? INT16_MIN : value > INT16_MAX ? INT16_MAX : value;
+}
+
+static void resample(void)
+{
+	int32_t error = (int32_t)AudioLevel() - AUDIO_TARGET;
+	if (error > AUDIO_TARGET) error = AUDIO_TARGET;
+
+	uint32_t ratio = step + (int32_t)(((int64_t)step * error) / (AUDIO_TARGET * 200));
+
+	while (true) {
+		size_t count, produced = 0;
+		uint32_t *samples = reserve(&count);
+
+		while (produced < count && (position >> 16) + RESAMPLE_TAPS <= history_len) {
+			int16_t (*in)[2] = &history[position >> 16];
+			const int16_t *c = coef[(position & 0xFFFF) >> (16 - RESAMPLE_PHASE_BITS)];
+			int32_t l = 0, r = 0;
+
+			for (int tap = 0; tap < RESAMPLE_TAPS; tap++) {
+				l += in[tap][0] * c[tap];
+				r += in[tap][1] * c[tap];
+			}
+
+			samples[produced++] = (uint32_t)(uint16_t)clamp16((l + (1 << 13)) >> 14) << 16 |
+			                      (uint32_t)(uint16_t)clamp16((r + (1 << 13)) >> 14);
+			position += ratio;
+		}
+
+		commit(produced);
+
+		if ((position >> 16) + RESAMPLE_TAPS > history_len)
+			break;
+
+		if (!count) {
+			audio_stats.overruns++;
+			position = (history_len - RESAMPLE_TAPS + 1) << 16;
+			break;
+		}
+	}
+
+	size_t consumed = position >> 16;
+
+	memmove(history, history[consumed], (history_len - consumed) * sizeof(*history));
+	history_len -= consumed;
+	position -= consumed << 16;
+}
+
+void AudioReset(void)
+{
+	ASND_StopVoice(0);
+
+	playing = false;
+	ring_read = ring_write = 0;
+
+	memset(history, 0, sizeof(history));
+	history_len = RESAMPLE_TAPS / 2 - 1;
+	position = 0;
+}
+
+void AudioSetRate(unsigned rate)
+{
+	output_rate = ASND_GetAudioRate();
+
+	if (input_rate != rate) {
+		input_rate = rate;
+		step = ((uint64_t)input_rate << 16) / output_rate;
+		fill_coef();
+	}
+}
+
+size_t AudioLevel(void)
+{
+	return ring_write - ring_read;
+}
+
+size_t AudioWrite(const void *samples, size_t count)
+{
+	const int16_t (*in)[2] = samples;
+	size_t written = 0;
+
+	if (!step)
+		return 0;
+
+	while (written < count) {
+		size_t chunk = RESAMPLE_TAPS + RESAMPLE_INPUT - history_len;
+		if (chunk > count - written) chunk = count - written;
+
+		memcpy(history[history_len], in[written], chunk * sizeof(*history));
+		history_len += chunk;
+		written += chunk;
+
+		resample();
+	}
+
+	return written;
+}
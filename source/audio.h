@@ -0,0 +1,30 @@
+/* 
+ * Copyright (c) 2015-2025, Extrems' Corner.org
+ * 
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef GBI_AUDIO_H
+#define GBI_AUDIO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define AUDIO_BLOCK_SAMPLES 1024
+#define AUDIO_RING_SAMPLES  16384
+
+typedef struct {
+	uint32_t underruns;
+	uint32_t overruns;
+} audio_stats_t;
+
+extern audio_stats_t audio_stats;
+
+void AudioReset(void);
+void AudioSetRate(unsigned rate);
+size_t AudioLevel(void);
+size_t AudioWrite(const void *samples, size_t count);
+
+#endif /* GBI_AUDIO_H */
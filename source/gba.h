@@ -9,6 +9,7 @@
 #ifndef GBI_GBA_H
 #define GBI_GBA_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #define GBA_BUTTON_A      0x0100
@@ -29,6 +30,14 @@ uint32_t GBAReadCommand(int32_t chan);
 void GBAWriteCommand(int32_t chan, uint32_t val);
 void GBAInit(void);
 
+void GBAVideoConvertBGR5Rows(void *dst, void *src, int width, int y0, int y1);
 void GBAVideoConvertBGR5(void *dst, void *src, int width, int height);
+void GBAVideoConvertBGR5MemRows(void *dst, void *src, int width, int y0, int y1);
+void GBAVideoConvertBGR5Mem(void *dst, void *src, int width, int height);
+void GBAVideoConvertBGR5PlanarRows(void *dst[3], void *src, int width, int y0, int y1);
+
+struct VFile;
+void GBAROMBufferLoadBegin(struct VFile *vf);
+void GBAROMBufferLoadEnd(struct VFile *vf, bool loaded);
 
 #endif /* GBI_GBA_H */
@@ -8,11 +8,18 @@
 
 #include <gccore.h>
 #include <mgba-util/memory.h>
+#include <mgba-util/vfs.h>
+#include "gba.h"
 #include "vm/vm.h"
 
 uint32_t *romBuffer;
 size_t romBufferSize;
 
+#ifdef HW_DOL
+static bool romPaged;
+static ssize_t (*romRead)(struct VFile *vf, void *buffer, size_t size);
+#endif
+
 static void __attribute__((constructor)) allocateRomBuffer(void)
 {
 	#ifdef HW_DOL
@@ -23,8 +30,8 @@ static void __attribute__((constructor)) allocateRomBuffer(void)
 		AR_Init(NULL, 0);
 		ARQ_Init();
 
-		romBufferSize = AR_GetSize();
-		romBuffer = VM_Init(romBufferSize, 8 << 20);
+		romBuffer = VM_InitCompressed(romBufferSize, 8 << 20, AR_GetSize());
+		romPaged = romBuffer != NULL;
 	}
 	#else
 	romBufferSize = 32 << 20;
@@ -32,6 +39,56 @@ static void __attribute__((constructor)) allocateRomBuffer(void)
 	#endif
 }
 
+#ifdef HW_DOL
+static ssize_t _readROM(struct VFile *vf, void *buffer, size_t size)
+{
+	static uint8_t chunk[0x10000] ATTRIBUTE_ALIGN(32);
+	ssize_t count = 0, total = 0;
+
+	if ((uint8_t *)buffer <  (uint8_t *)romBuffer ||
+		(uint8_t *)buffer >= (uint8_t *)romBuffer + romBufferSize)
+		return romRead(vf, buffer, size);
+
+	while (size && (count = romRead(vf, chunk, size < sizeof(chunk) ? size : sizeof(chunk))) > 0) {
+		ssize_t written = VM_Write((uint8_t *)buffer + total, chunk, count);
+		total += written;
+		size  -= written;
+
+		if (written < count)
+			break;
+	}
+
+	return total ? total : count;
+}
+#endif
+
+void GBAROMBufferLoadBegin(struct VFile *vf)
+{
+	#ifdef HW_DOL
+	if (!romPaged || romRead)
+		return;
+
+	romRead = vf->read;
+	vf->read = _readROM;
+	#endif
+}
+
+void GBAROMBufferLoadEnd(struct VFile *vf, bool loaded)
+{
+	#ifdef HW_DOL
+	if (!romRead)
+		return;
+
+	vf->read = romRead;
+	romRead = NULL;
+
+	if (loaded) {
+		size_t size = vf->size(vf);
+		VM_Seal(romBuffer, size < romBufferSize ? size : romBufferSize, true);
+	}
+	#endif
+}
+
 void *anonymousMemoryMap(size_t size)
 {
 	return malloc(size);
@@ -9,11 +9,17 @@
 #include <gccore.h>
 #include "gba.h"
 
-void GBAVideoConvertBGR5(void *dst, void *src, int width, int height)
+void GBAVideoConvertBGR5Rows(void *dst, void *src, int width, int y0, int y1)
 {
-	GX_RedirectWriteGatherPipe(dst);
+	y0 &= ~3;
+	y1 = (y1 + 3) & ~3;
+
+	if (y0 >= y1)
+		return;
+
+	GX_RedirectWriteGatherPipe(dst + y0 * width * sizeof(uint16_t));
 
-	uint16_t *src0 = src - 4;
+	uint16_t *src0 = src + y0 * width * sizeof(uint16_t) - 4;
 	uint16_t *src1 = src0 + width;
 	uint16_t *src2 = src1 + width;
 	uint16_t *src3 = src2 + width;
@@ -23,7 +29,7 @@ void GBAVideoConvertBGR5(void *dst, void *src, int width, int height)
 	register int reg20, reg21;
 	register int reg30, reg31;
 
-	int lines = height >> 2;
+	int lines = (y1 - y0) >> 2;
 
 	while (lines--) {
 		int tiles = width >> 2;
@@ -75,3 +81,101 @@ void GBAVideoConvertBGR5(void *dst, void *src, int width, int height)
 
 	GX_RestoreWriteGatherPipe();
 }
+
+void GBAVideoConvertBGR5(void *dst, void *src, int width, int height)
+{
+	GBAVideoConvertBGR5Rows(dst, src, width, 0, height);
+}
+
+void GBAVideoConvertBGR5MemRows(void *dst, void *src, int width, int y0, int y1)
+{
+	y0 &= ~3;
+	y1 = (y1 + 3) & ~3;
+
+	if (y0 >= y1)
+		return;
+
+	uint32_t *dst32 = dst + y0 * width * sizeof(uint16_t);
+
+	uint32_t *src0 = src + y0 * width * sizeof(uint16_t);
+	uint32_t *src1 = src0 + (width >> 1);
+	uint32_t *src2 = src1 + (width >> 1);
+	uint32_t *src3 = src2 + (width >> 1);
+
+	int lines = (y1 - y0) >> 2;
+
+	while (lines--) {
+		int tiles = width >> 2;
+
+		do {
+			dst32[0] = *src0++ | 0x80008000;
+			dst32[1] = *src0++ | 0x80008000;
+			dst32[2] = *src1++ | 0x80008000;
+			dst32[3] = *src1++ | 0x80008000;
+			dst32[4] = *src2++ | 0x80008000;
+			dst32[5] = *src2++ | 0x80008000;
+			dst32[6] = *src3++ | 0x80008000;
+			dst32[7] = *src3++ | 0x80008000;
+			dst32 += 8;
+		} while (--tiles);
+
+		src0 += (width >> 1) * 3;
+		src1 += (width >> 1) * 3;
+		src2 += (width >> 1) * 3;
+		src3 += (width >> 1) * 3;
+	}
+
+	DCFlushRange(dst + y0 * width * sizeof(uint16_t), (y1 - y0) * width * sizeof(uint16_t));
+}
+
+void GBAVideoConvertBGR5Mem(void *dst, void *src, int width, int height)
+{
+	GBAVideoConvertBGR5MemRows(dst, src, width, 0, height);
+}
+
+void GBAVideoConvertBGR5PlanarRows(void *dst[3], void *src, int width, int y0, int y1)
+{
+	static const uint8_t expand[32] = {
+		0x00, 0x08, 0x10, 0x18, 0x21, 0x29, 0x31, 0x39,
+		0x42, 0x4A, 0x52, 0x5A, 0x63, 0x6B, 0x73, 0x7B,
+		0x84, 0x8C, 0x94, 0x9C, 0xA5, 0xAD, 0xB5, 0xBD,
+		0xC6, 0xCE, 0xD6, 0xDE, 0xE7, 0xEF, 0xF7, 0xFF,
+	};
+
+	y0 &= ~3;
+	y1 = (y1 + 3) & ~3;
+
+	if (y0 >= y1)
+		return;
+
+	uint32_t *r32 = dst[0] + y0 * width;
+	uint32_t *g32 = dst[1] + y0 * width;
+	uint32_t *b32 = dst[2] + y0 * width;
+
+	for (int y = y0; y < y1; y += 4) {
+		for (int x = 0; x < width; x += 8) {
+			for (int row = 0; row < 4; row++) {
+				uint16_t *src16 = src + ((y + row) * width + x) * sizeof(uint16_t);
+
+				for (int half = 0; half < 2; half++) {
+					uint32_t r = 0, g = 0, b = 0;
+
+					for (int i = 0; i < 4; i++) {
+						uint16_t pixel = *src16++;
+						r = r << 8 | expand[pixel       & 0x1F];
+						g = g << 8 | expand[pixel >>  5 & 0x1F];
+						b = b << 8 | expand[pixel >> 10 & 0x1F];
+					}
+
+					*r32++ = r;
+					*g32++ = g;
+					*b32++ = b;
+				}
+			}
+		}
+	}
+
+	DCFlushRange(dst[0] + y0 * width, (y1 - y0) * width);
+	DCFlushRange(dst[1] + y0 * width, (y1 - y0) * width);
+	DCFlushRange(dst[2] + y0 * width, (y1 - y0) * width);
+}
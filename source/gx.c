@@ -9,6 +9,8 @@
 #include <malloc.h>
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <gccore.h>
 #include <ogc/machine/asm.h>
 #include <zlib.h>
@@ -17,6 +19,7 @@
 #include "util.h"
 
 static void *fifo;
+static gx_arena_t *active;
 static GXTexRegion texregion[24];
 static GXTlutRegion tlutregion[20];
 
@@ -120,57 +123,191 @@ void *GXAllocBuffer(uint32_t size)
 	return ptr;
 }
 
-static double trc_linear(int ch, double f) {
+void GXCompileDispList(gx_displist_t *displist, void (*compile)(uint32_t), uint32_t arg)
+{
+	free(displist->list);
+
+	// compiled outside of a frame, leave the live state as it was
+	GX_SetMisc(GX_MT_DL_SAVE_CTX, GX_ENABLE);
+
+	displist->list = GXAllocBuffer(GX_FIFO_MINSIZE);
+	GX_BeginDispList(displist->list, GX_FIFO_MINSIZE);
+
+	compile(arg);
+
+	displist->size = GX_EndDispList();
+	displist->list = realloc_in_place(displist->list, displist->size);
+
+	GX_SetMisc(GX_MT_DL_SAVE_CTX, GX_DISABLE);
+}
+
+void GXFreeDispList(gx_displist_t *displist)
+{
+	free(displist->list);
+
+	displist->list = NULL;
+	displist->size = 0;
+}
+
+static uint32_t arena_round(uint32_t size)
+{
+	return (size + PPC_CACHE_ALIGNMENT - 1) & ~(PPC_CACHE_ALIGNMENT - 1);
+}
+
+void GXAllocArena(gx_arena_t *arena, uint32_t size)
+{
+	size = arena_round(size);
+
+	if (arena->size < size) {
+		free(arena->base);
+		arena->base = memalign(PPC_CACHE_ALIGNMENT, size);
+		arena->size = arena->base ? size : 0;
+	}
+
+	arena->used = 0;
+}
+
+void GXFreeArena(gx_arena_t *arena)
+{
+	free(arena->base);
+
+	arena->base = NULL;
+	arena->size = 0;
+	arena->used = 0;
+}
+
+void GXSetArena(gx_arena_t *arena)
+{
+	active = arena;
+}
+
+uint32_t GXGetArenaSurfaceSize(uint16_t width, uint16_t height, uint8_t format, uint8_t planes)
+{
+	uint32_t size = arena_round(GX_GetTexBufferSize(width, height, format, GX_FALSE, 0));
+
+	if (format == GX_TF_CI8)
+		size += arena_round(256 * sizeof(hword_t));
+
+	return planes * size +
+		arena_round(planes * sizeof(void *)) * 2 +
+		arena_round(planes * sizeof(GXTexObj)) +
+		arena_round(planes * sizeof(GXTlutObj)) +
+		arena_round(4 * sizeof(GXTexRegion));
+}
+
+static void *arena_alloc(uint32_t size)
+{
+	void *ptr;
+
+	size = arena_round(size);
+
+	if (!active || active->size - active->used < size)
+		return NULL;
+
+	ptr = active->base + active->used;
+	active->used += size;
+
+	DCZeroRange(ptr, size);
+	return ptr;
+}
+
+static bool regions_overlap(uint32_t tmem[], uint32_t size, uint8_t count)
+{
+	for (int i = 0; i < count; i++)
+		for (int j = i + 1; j < count; j++)
+			if (tmem[i] < tmem[j] + size && tmem[j] < tmem[i] + size)
+				return true;
+
+	return false;
+}
+
+static void *surface_calloc(size_t count, size_t size)
+{
+	void *ptr = arena_alloc(count * size);
+	return ptr ? ptr : calloc(count, size);
+}
+
+static void *surface_buffer(uint32_t size)
+{
+	void *ptr = arena_alloc(size);
+	return ptr ? ptr : GXAllocBuffer(size);
+}
+
+static void surface_free(gx_surface_t *surface, void *ptr)
+{
+	if (surface->arena &&
+		(uint8_t *)ptr >= (uint8_t *)surface->arena->base &&
+		(uint8_t *)ptr <  (uint8_t *)surface->arena->base + surface->arena->size)
+		return;
+
+	free(ptr);
+}
+
+typedef struct {
+	double gamma, alpha;
+	double kappa, phi;
+} trc_t;
+
+typedef struct {
+	uint8_t trc;
+	uint8_t dither;
+	float gamma, alpha;
+	float brightness, contrast;
+} lut_key_t;
+
+static struct {
+	lut_key_t key;
+	hword_t lut[256];
+} lut_cache[8];
+
+static uint32_t lut_next;
+
+static double trc_linear(const trc_t *trc, double f) {
 	return f;
 }
 
-static double trc_gamma(int ch, double f) {
+static double trc_gamma(const trc_t *trc, double f) {
 	double V = fabs(f);
-	double L = pow(V, state.input_gamma[ch]);
+	double L = pow(V, trc->gamma);
 	return copysign(L, f);
 }
 
-static double trc_piecewise(int ch, double f) {
+static double trc_piecewise(const trc_t *trc, double f) {
 	double V = fabs(f);
 	double L;
 
-	if (state.input_gamma[ch] <= 1. + state.input_alpha[ch]) {
-		L = pow(V, state.input_gamma[ch]);
-	} else {
-		double kappa = state.input_alpha[ch] / (state.input_gamma[ch] - 1.);
-		double phi = pow((1. + state.input_alpha[ch]) / state.input_gamma[ch], state.input_gamma[ch])
-		           * pow((state.input_gamma[ch] - 1.) / state.input_alpha[ch], state.input_gamma[ch] - 1.);
-		L = V <= kappa ? V / phi : pow((V + state.input_alpha[ch]) / (1. + state.input_alpha[ch]), state.input_gamma[ch]);
-	}
+	if (trc->gamma <= 1. + trc->alpha)
+		L = pow(V, trc->gamma);
+	else L = V <= trc->kappa ? V / trc->phi : pow((V + trc->alpha) / (1. + trc->alpha), trc->gamma);
 
 	return copysign(L, f);
 }
 
-static double trc_gamma22(int ch, double f) {
+static double trc_gamma22(const trc_t *trc, double f) {
 	double V = fabs(f);
 	double L = pow(V, 2.2);
 	return copysign(L, f);
 }
 
-static double trc_iec61966(int ch, double f) {
+static double trc_iec61966(const trc_t *trc, double f) {
 	double V = fabs(f);
 	double L = V <= .04045 ? V / 12.92 : pow((V + .055) / 1.055, 2.4);
 	return copysign(L, f);
 }
 
-static double trc_itu709(int ch, double f) {
+static double trc_itu709(const trc_t *trc, double f) {
 	double V = fabs(f);
 	double L = V <= .081 ? V / 4.5 : pow((V + .099) / 1.099, 1/.45);
 	return copysign(L, f);
 }
 
-static double trc_smpte240(int ch, double f) {
+static double trc_smpte240(const trc_t *trc, double f) {
 	double V = fabs(f);
 	double L = V <= .0912 ? V / 4. : pow((V + .1115) / 1.1115, 1/.45);
 	return copysign(L, f);
 }
 
-static double (*trc_funcs[])(int, double) = {
+static double (*trc_funcs[])(const trc_t *, double) = {
 	trc_linear,
 	trc_gamma,
 	trc_piecewise,
@@ -180,20 +317,121 @@ static double (*trc_funcs[])(int, double) = {
 	trc_smpte240
 };
 
-static void fill_lut(int ch, double (*func)(int, double), hword_t *lut)
+static void trc_init(trc_t *trc, const lut_key_t *key)
+{
+	trc->gamma = key->gamma;
+	trc->alpha = key->alpha;
+	trc->kappa = 0.;
+	trc->phi = 1.;
+
+	if (trc->gamma > 1. + trc->alpha) {
+		trc->kappa = trc->alpha / (trc->gamma - 1.);
+		trc->phi = pow((1. + trc->alpha) / trc->gamma, trc->gamma)
+		         * pow((trc->gamma - 1.) / trc->alpha, trc->gamma - 1.);
+	}
+}
+
+static void build_lut(const lut_key_t *key, hword_t *lut)
 {
-	double a = func(ch, state.contrast[ch]), b = state.brightness[ch] / state.contrast[ch];
+	double (*func)(const trc_t *, double) = trc_funcs[key->trc];
+	trc_t trc;
+
+	trc_init(&trc, key);
+
+	double a = func(&trc, key->contrast), b = key->brightness / key->contrast;
+	double scale = key->dither ? a * 65535. : a * 255.;
 
 	for (int i = 0; i < 256; i++) {
-		double f = a * func(ch, i / 255. + b);
+		double f = scale * func(&trc, i / 255. + b) + .5;
 
-		if (state.dither) {
-			lut[i].u16 = f * 65535. + .5;
+		if (key->dither) {
+			lut[i].u16 = f;
 		} else {
-			lut[i].u8[0] = f * 255. + .5;
+			lut[i].u8[0] = f;
 			lut[i].u8[1] = 0;
 		}
 	}
+}
+
+static bool find_lut(const lut_key_t *key, hword_t *lut)
+{
+	for (uint32_t i = 0; i < lut_next && i < ARRAY_ELEMS(lut_cache); i++) {
+		if (!memcmp(&lut_cache[i].key, key, sizeof(*key))) {
+			memcpy(lut, lut_cache[i].lut, sizeof(lut_cache[i].lut));
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool load_lut(const lut_key_t *key, hword_t *lut)
+{
+	char path[64];
+	lut_key_t stored;
+	bool loaded = false;
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "/mGBA/cache/lut-%08lx.bin", crc32(0, (const Bytef *)key, sizeof(*key)));
+
+	if ((fp = fopen(path, "rb"))) {
+		loaded = fread(&stored, sizeof(stored), 1, fp) == 1 &&
+			!memcmp(&stored, key, sizeof(*key)) &&
+			fread(lut, sizeof(hword_t), 256, fp) == 256;
+		fclose(fp);
+	}
+
+	return loaded;
+}
+
+static void store_lut(const lut_key_t *key, const hword_t *lut, bool persist)
+{
+	uint32_t index = lut_next++ % ARRAY_ELEMS(lut_cache);
+	char path[64];
+	FILE *fp;
+
+	lut_cache[index].key = *key;
+	memcpy(lut_cache[index].lut, lut, sizeof(lut_cache[index].lut));
+
+	if (!persist)
+		return;
+
+	mkdir("/mGBA/cache", 0755);
+	snprintf(path, sizeof(path), "/mGBA/cache/lut-%08lx.bin", crc32(0, (const Bytef *)key, sizeof(*key)));
+
+	if ((fp = fopen(path, "wb"))) {
+		fwrite(key, sizeof(*key), 1, fp);
+		fwrite(lut, sizeof(hword_t), 256, fp);
+		fclose(fp);
+	}
+}
+
+static void fill_lut(int ch, hword_t *lut)
+{
+	lut_key_t key;
+
+	memset(&key, 0, sizeof(key));
+	key.trc        = state.input_trc;
+	key.dither     = state.dither != DITHER_NONE;
+	key.gamma      = state.input_gamma[ch];
+	key.alpha      = state.input_alpha[ch];
+	key.brightness = state.brightness[ch];
+	key.contrast   = state.contrast[ch];
+
+	// parameters that the curve ignores must not split the cache
+	if (key.trc != TRC_GAMMA && key.trc != TRC_PIECEWISE)
+		key.gamma = 0.;
+	if (key.trc != TRC_PIECEWISE)
+		key.alpha = 0.;
+
+	if (!find_lut(&key, lut)) {
+		if (load_lut(&key, lut))
+			store_lut(&key, lut, false);
+		else {
+			build_lut(&key, lut);
+			store_lut(&key, lut, true);
+		}
+	}
 
 	DCStoreRange(lut, 256 * sizeof(hword_t));
 }
@@ -205,22 +443,24 @@ void GXAllocSurface(gx_surface_t *surface, uint16_t width, uint16_t height, uint
 	surface->planes = planes;
 	surface->slices = 0;
 	surface->size = size;
+	surface->arena = active;
+	surface->overlap = false;
 
-	surface->buf = calloc(planes, sizeof(void *));
-	surface->lutbuf = calloc(planes, sizeof(void *));
+	surface->buf = surface_calloc(planes, sizeof(void *));
+	surface->lutbuf = surface_calloc(planes, sizeof(void *));
 
-	surface->obj = calloc(planes, sizeof(GXTexObj));
-	surface->lutobj = calloc(planes, sizeof(GXTlutObj));
+	surface->obj = surface_calloc(planes, sizeof(GXTexObj));
+	surface->lutobj = surface_calloc(planes, sizeof(GXTlutObj));
 
 	for (int i = 0; i < surface->planes; i++) {
-		surface->buf[i] = GXAllocBuffer(surface->size);
+		surface->buf[i] = surface_buffer(surface->size);
 
 		switch (format) {
 			case GX_TF_CI4:
 				break;
 			case GX_TF_CI8:
-				surface->lutbuf[i] = GXAllocBuffer(256 * sizeof(hword_t));
-				fill_lut(i, trc_funcs[state.input_trc], surface->lutbuf[i]);
+				surface->lutbuf[i] = surface_buffer(256 * sizeof(hword_t));
+				fill_lut(i, surface->lutbuf[i]);
 
 				GX_InitTlutObj(&surface->lutobj[i], surface->lutbuf[i], GX_TL_IA8, 256);
 				GX_InitTexObjCI(&surface->obj[i], surface->buf[i], width, height, format, GX_CLAMP, GX_CLAMP, GX_FALSE, GX_TLUT0 + i);
@@ -242,14 +482,16 @@ void GXAllocSurfaceSliced(gx_surface_t *surface, uint16_t width, uint16_t height
 	surface->planes = 1;
 	surface->slices = slices;
 	surface->size = size;
+	surface->arena = active;
+	surface->overlap = false;
 
-	surface->buf = calloc(slices, sizeof(void *));
-	surface->lutbuf = calloc(1, sizeof(void *));
+	surface->buf = surface_calloc(slices, sizeof(void *));
+	surface->lutbuf = surface_calloc(1, sizeof(void *));
 
-	surface->obj = calloc(1 + slices, sizeof(GXTexObj));
-	surface->lutobj = calloc(1, sizeof(GXTlutObj));
+	surface->obj = surface_calloc(1 + slices, sizeof(GXTexObj));
+	surface->lutobj = surface_calloc(1, sizeof(GXTlutObj));
 
-	*surface->buf = GXAllocBuffer(surface->size * surface->slices);
+	*surface->buf = surface_buffer(surface->size * surface->slices);
 
 	switch (format) {
 		case GX_TF_CI4:
@@ -286,8 +528,9 @@ void GXPreloadSurface(gx_surface_t *surface, uint32_t tmem_even, uint32_t tmem_o
 {
 	surface->shadows = count;
 	surface->shadow = 0;
+	surface->overlap = false;
 
-	surface->region = calloc(count, sizeof(GXTexRegion));
+	surface->region = surface_calloc(count, sizeof(GXTexRegion));
 
 	if (tmem_even == tmem_odd) {
 		for (int i = 0; i < count; i++) {
@@ -309,8 +552,11 @@ void GXPreloadSurfacev(gx_surface_t *surface, uint32_t tmem_even[], uint32_t tme
 {
 	surface->shadows = count;
 	surface->shadow = 0;
+	surface->overlap = tmem_odd ?
+		regions_overlap(tmem_even, surface->size / 2, count) || regions_overlap(tmem_odd, surface->size / 2, count) :
+		regions_overlap(tmem_even, surface->size, count);
 
-	surface->region = calloc(count, sizeof(GXTexRegion));
+	surface->region = surface_calloc(count, sizeof(GXTexRegion));
 
 	if (!tmem_odd) {
 		for (int i = 0; i < count; i++) {
@@ -329,8 +575,9 @@ void GXCacheSurface(gx_surface_t *surface, uint32_t tmem_even, uint32_t tmem_odd
 {
 	surface->shadows = count;
 	surface->shadow = 0;
+	surface->overlap = false;
 
-	surface->region = calloc(count, sizeof(GXTexRegion));
+	surface->region = surface_calloc(count, sizeof(GXTexRegion));
 
 	if (tmem_even == tmem_odd) {
 		for (int i = 0; i < count; i++) {
@@ -352,8 +599,10 @@ void GXCacheSurfacev(gx_surface_t *surface, uint32_t tmem_even[], uint32_t tmem_
 {
 	surface->shadows = count;
 	surface->shadow = 0;
+	surface->overlap = regions_overlap(tmem_even, 0x8000, count) ||
+		(tmem_odd && regions_overlap(tmem_odd, 0x8000, count));
 
-	surface->region = calloc(count, sizeof(GXTexRegion));
+	surface->region = surface_calloc(count, sizeof(GXTexRegion));
 
 	if (!tmem_odd) {
 		for (int i = 0; i < count; i++) {
@@ -390,15 +639,17 @@ void GXSetSurfaceTlut(gx_surface_t *surface, uint32_t tlut)
 
 void GXFreeSurface(gx_surface_t *surface)
 {
-	bulk_free(surface->buf, surface->planes);
-	bulk_free(surface->lutbuf, surface->planes);
+	for (int i = 0; i < surface->planes; i++) {
+		surface_free(surface, surface->buf[i]);
+		surface_free(surface, surface->lutbuf[i]);
+	}
 
-	free(surface->buf);
-	free(surface->lutbuf);
+	surface_free(surface, surface->buf);
+	surface_free(surface, surface->lutbuf);
 
-	free(surface->obj);
-	free(surface->region);
-	free(surface->lutobj);
+	surface_free(surface, surface->obj);
+	surface_free(surface, surface->region);
+	surface_free(surface, surface->lutobj);
 
 	surface->planes = 0;
 	surface->slices = 0;
@@ -410,6 +661,7 @@ void GXFreeSurface(gx_surface_t *surface)
 	surface->obj = NULL;
 	surface->region = NULL;
 	surface->lutobj = NULL;
+	surface->arena = NULL;
 }
 
 void *GXOpenMem(void *buffer, int size)
@@ -14,6 +14,17 @@
 #include <ogc/gx.h>
 #include "video.h"
 
+typedef struct {
+	void *base;
+	uint32_t size;
+	uint32_t used;
+} gx_arena_t;
+
+typedef struct {
+	void *list;
+	uint32_t size;
+} gx_displist_t;
+
 typedef struct {
 	uint8_t planes;
 	uint8_t slices;
@@ -23,9 +34,11 @@ typedef struct {
 	void **lutbuf;
 	GXTexObj *obj;
 	GXTexRegion *region;
+	bool overlap;
 	GXTlutObj *lutobj;
 	rect_t rect;
 	bool dirty;
+	gx_arena_t *arena;
 } gx_surface_t;
 
 typedef union {
@@ -50,6 +63,24 @@ typedef union {
 	};
 } gx_efb64_t;
 
+enum {
+	GX_PASS_CONVERT = 0,
+	GX_PASS_PLANAR,
+	GX_PASS_PRESCALE,
+	GX_PASS_PREVIEW,
+	GX_PASS_OVERLAY,
+	GX_PASS_FONT,
+	GX_PASS_CURSOR,
+	GX_PASS_COPY,
+	GX_PASS_MAX
+};
+
+typedef struct {
+	uint64_t min;
+	uint64_t avg;
+	uint64_t max;
+} gx_profile_t;
+
 static inline float GXCast1u8f32(uint8_t inval)
 {
 	float outval;
@@ -94,6 +125,12 @@ static inline uint16_t GXCast1f32u16(float inval)
 
 void GXInit(void);
 void *GXAllocBuffer(uint32_t size);
+void GXCompileDispList(gx_displist_t *displist, void (*compile)(uint32_t), uint32_t arg);
+void GXFreeDispList(gx_displist_t *displist);
+void GXAllocArena(gx_arena_t *arena, uint32_t size);
+void GXFreeArena(gx_arena_t *arena);
+void GXSetArena(gx_arena_t *arena);
+uint32_t GXGetArenaSurfaceSize(uint16_t width, uint16_t height, uint8_t format, uint8_t planes);
 void GXAllocSurface(gx_surface_t *surface, uint16_t width, uint16_t height, uint8_t format, uint8_t planes);
 void GXAllocSurfaceSliced(gx_surface_t *surface, uint16_t width, uint16_t height, uint8_t format, uint8_t slices);
 void GXPreloadSurface(gx_surface_t *surface, uint32_t tmem_even, uint32_t tmem_odd, uint8_t count);
@@ -124,6 +161,7 @@ void GXOverlayReadFile(const char *file, int index);
 void GXPackedApplyMix(gx_surface_t *dst, gx_surface_t *src);
 void GXPackedApplyYUV(gx_surface_t *dst, gx_surface_t *src);
 
+void GXPlanarCopyChannel(GXTexObj texobj, rect_t dst_rect, rect_t src_rect, uint8_t channel);
 void GXPlanarApply(gx_surface_t *dst, gx_surface_t *src);
 void GXPlanarApplyBlend(gx_surface_t *dst, gx_surface_t *src);
 void GXPlanarApplyDeflicker(gx_surface_t *dst, gx_surface_t *src);
@@ -132,6 +170,7 @@ void GXPlanarApplyScale2x(gx_surface_t *dst, gx_surface_t *src, bool blend);
 void GXPlanarApplyEagle2x(gx_surface_t *dst, gx_surface_t *src);
 void GXPlanarApplyScan2x(gx_surface_t *dst, gx_surface_t *src, bool field);
 void GXPlanarAllocState(void);
+void GXPlanarFreeState(void);
 
 void GXPrescaleApply(gx_surface_t *dst, gx_surface_t *src);
 void GXPrescaleApplyDither(gx_surface_t *dst, gx_surface_t *src);
@@ -140,7 +179,10 @@ void GXPrescaleApplyBlend(gx_surface_t *dst, gx_surface_t **src, uint8_t *alpha,
 void GXPrescaleApplyBlendDither(gx_surface_t *dst, gx_surface_t **src, uint8_t *alpha, uint32_t count);
 void GXPrescaleApplyBlendDitherFast(gx_surface_t *dst, gx_surface_t **src, uint8_t *alpha, uint32_t count);
 void GXPrescaleAllocState(void);
+void GXPrescaleFreeState(void);
 rect_t GXPrescaleGetRect(uint16_t width, uint16_t height);
+void GXPrescaleAdapt(uint64_t gx, uint64_t period);
+unsigned GXPrescaleGetFactor(void);
 
 void GXPreviewDrawRect(GXTexObj texobj[3], rect_t dst_rect, rect_t src_rect);
 void GXPreviewAllocState(void);
@@ -150,4 +192,24 @@ void GXSolidDrawRect(rect_t rect, uint32_t color[4]);
 void GXSolidAllocState(void);
 void GXSolidSetState(void);
 
+void GXReferenceAlloc(uint16_t width, uint16_t height);
+void GXReferenceFree(void);
+void GXReferenceApply(gx_surface_t *dst, const uint16_t *src);
+uint32_t GXReferenceCompare(gx_surface_t *ref, gx_surface_t *out, uint8_t *error);
+void GXReferenceVerify(gx_surface_t *ref, gx_surface_t *out, gx_surface_t *conv, const uint16_t *src);
+
+bool GXTraceOpen(const char *file);
+void GXTraceClose(void);
+void GXTraceBegin(int pass);
+void GXTraceEnd(int pass);
+void GXTraceAddBytes(int pass, uint32_t bytes);
+void GXTraceFrame(void);
+const char *GXTraceName(int pass);
+
+void GXProfileStart(void);
+void GXProfileStop(const char *file);
+bool GXProfileToken(uint16_t token);
+void GXProfileFrame(void);
+const gx_profile_t *GXProfileGet(int pass);
+
 #endif /* GBI_GX_H */
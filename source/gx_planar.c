@@ -45,7 +45,17 @@ static float indtexmtx[][2][3] = {
 
 static GXTexObj indtexobj[3];
 
-static void GXPlanarCopyChannel(GXTexObj texobj, rect_t dst_rect, rect_t src_rect, uint8_t channel)
+static struct {
+	gx_displist_t apply;
+	gx_displist_t blend;
+	gx_displist_t deflicker;
+	gx_displist_t scale2xex;
+	gx_displist_t scale2x[2];
+	gx_displist_t eagle2x;
+	gx_displist_t scan2x[2];
+} displist;
+
+void GXPlanarCopyChannel(GXTexObj texobj, rect_t dst_rect, rect_t src_rect, uint8_t channel)
 {
 	void *ptr;
 	uint16_t width, height;
@@ -79,7 +89,7 @@ static void GXPlanarCopyChannel(GXTexObj texobj, rect_t dst_rect, rect_t src_rec
 	GX_CopyTex(ptr, channel == GX_CH_BLUE ? GX_TRUE : GX_FALSE);
 }
 
-void GXPlanarApply(gx_surface_t *dst, gx_surface_t *src)
+static void GXPlanarState(uint32_t arg)
 {
 	Mtx44 projection;
 	guOrtho(projection, 0., 1024., 0., 1024., 0., 1.);
@@ -119,6 +129,11 @@ void GXPlanarApply(gx_surface_t *dst, gx_surface_t *src)
 
 	GX_SetPixelFmt(GX_PF_RGB8_Z24, GX_ZC_LINEAR);
 	GX_SetCopyFilter(GX_FALSE, NULL, GX_FALSE, NULL);
+}
+
+void GXPlanarApply(gx_surface_t *dst, gx_surface_t *src)
+{
+	GX_CallDispList(displist.apply.list, displist.apply.size);
 
 	if (src->dirty) GX_PreloadEntireTexture(&src->obj[0], &src->region[0]);
 	GX_LoadTexObjPreloaded(&src->obj[0], &src->region[0], GX_TEXMAP0);
@@ -129,7 +144,7 @@ void GXPlanarApply(gx_surface_t *dst, gx_surface_t *src)
 	dst->dirty = true; src->dirty = false;
 }
 
-void GXPlanarApplyBlend(gx_surface_t *dst, gx_surface_t *src)
+static void GXPlanarStateBlend(uint32_t arg)
 {
 	uint8_t alpha[3] = {
 		state.filter_weight[0] * 255. + .5,
@@ -186,6 +201,11 @@ void GXPlanarApplyBlend(gx_surface_t *dst, gx_surface_t *src)
 
 	GX_SetPixelFmt(GX_PF_RGB8_Z24, GX_ZC_LINEAR);
 	GX_SetCopyFilter(GX_FALSE, NULL, GX_FALSE, NULL);
+}
+
+void GXPlanarApplyBlend(gx_surface_t *dst, gx_surface_t *src)
+{
+	GX_CallDispList(displist.blend.list, displist.blend.size);
 
 	if (src->dirty) {
 		src->shadow = (src->shadow - 1 + src->shadows) % src->shadows;
@@ -200,7 +220,7 @@ void GXPlanarApplyBlend(gx_surface_t *dst, gx_surface_t *src)
 	dst->dirty = true; src->dirty = false;
 }
 
-void GXPlanarApplyDeflicker(gx_surface_t *dst, gx_surface_t *src)
+static void GXPlanarStateDeflicker(uint32_t arg)
 {
 	uint8_t alpha[3] = {
 		state.filter_weight[0] * 255. + .5,
@@ -264,6 +284,11 @@ void GXPlanarApplyDeflicker(gx_surface_t *dst, gx_surface_t *src)
 
 	GX_SetPixelFmt(GX_PF_RGB8_Z24, GX_ZC_LINEAR);
 	GX_SetCopyFilter(GX_FALSE, NULL, GX_FALSE, NULL);
+}
+
+void GXPlanarApplyDeflicker(gx_surface_t *dst, gx_surface_t *src)
+{
+	GX_CallDispList(displist.deflicker.list, displist.deflicker.size);
 
 	if (src->dirty) {
 		src->shadow = (src->shadow - 1 + src->shadows) % src->shadows;
@@ -279,7 +304,7 @@ void GXPlanarApplyDeflicker(gx_surface_t *dst, gx_surface_t *src)
 	dst->dirty = true; src->dirty = false;
 }
 
-void GXPlanarApplyScale2xEx(gx_surface_t *dst, gx_surface_t *src, gx_surface_t *yuv)
+static void GXPlanarStateScale2xEx(uint32_t arg)
 {
 	Mtx44 projection;
 	guOrtho(projection, 0., 1024., 0., 1024., 0., 1.);
@@ -398,6 +423,11 @@ void GXPlanarApplyScale2xEx(gx_surface_t *dst, gx_surface_t *src, gx_surface_t *
 
 	GX_SetPixelFmt(GX_PF_RGB8_Z24, GX_ZC_LINEAR);
 	GX_SetCopyFilter(GX_FALSE, NULL, GX_FALSE, NULL);
+}
+
+void GXPlanarApplyScale2xEx(gx_surface_t *dst, gx_surface_t *src, gx_surface_t *yuv)
+{
+	GX_CallDispList(displist.scale2xex.list, displist.scale2xex.size);
 
 	if (src->dirty) GX_PreloadEntireTexture(&src->obj[0], &src->region[0]);
 	if (yuv->dirty) GX_PreloadEntireTexture(&yuv->obj[0], &yuv->region[0]);
@@ -412,7 +442,7 @@ void GXPlanarApplyScale2xEx(gx_surface_t *dst, gx_surface_t *src, gx_surface_t *
 	dst->dirty = true; src->dirty = false; yuv->dirty = false;
 }
 
-void GXPlanarApplyScale2x(gx_surface_t *dst, gx_surface_t *src, bool blend)
+static void GXPlanarStateScale2x(uint32_t blend)
 {
 	Mtx44 projection;
 	guOrtho(projection, 0., 1024., 0., 1024., 0., 1.);
@@ -508,6 +538,11 @@ void GXPlanarApplyScale2x(gx_surface_t *dst, gx_surface_t *src, bool blend)
 
 	GX_SetPixelFmt(GX_PF_RGB8_Z24, GX_ZC_LINEAR);
 	GX_SetCopyFilter(GX_FALSE, NULL, GX_FALSE, NULL);
+}
+
+void GXPlanarApplyScale2x(gx_surface_t *dst, gx_surface_t *src, bool blend)
+{
+	GX_CallDispList(displist.scale2x[blend].list, displist.scale2x[blend].size);
 
 	if (src->dirty) GX_PreloadEntireTexture(&src->obj[0], &src->region[0]);
 	GX_LoadTexObjPreloaded(&src->obj[0], &src->region[0], GX_TEXMAP0);
@@ -520,7 +555,7 @@ void GXPlanarApplyScale2x(gx_surface_t *dst, gx_surface_t *src, bool blend)
 	dst->dirty = true; src->dirty = false;
 }
 
-void GXPlanarApplyEagle2x(gx_surface_t *dst, gx_surface_t *src)
+static void GXPlanarStateEagle2x(uint32_t arg)
 {
 	Mtx44 projection;
 	guOrtho(projection, 0., 1024., 0., 1024., 0., 1.);
@@ -585,6 +620,11 @@ void GXPlanarApplyEagle2x(gx_surface_t *dst, gx_surface_t *src)
 
 	GX_SetPixelFmt(GX_PF_RGB8_Z24, GX_ZC_LINEAR);
 	GX_SetCopyFilter(GX_FALSE, NULL, GX_FALSE, NULL);
+}
+
+void GXPlanarApplyEagle2x(gx_surface_t *dst, gx_surface_t *src)
+{
+	GX_CallDispList(displist.eagle2x.list, displist.eagle2x.size);
 
 	if (src->dirty) GX_PreloadEntireTexture(&src->obj[0], &src->region[0]);
 	GX_LoadTexObjPreloaded(&src->obj[0], &src->region[0], GX_TEXMAP0);
@@ -599,7 +639,7 @@ void GXPlanarApplyEagle2x(gx_surface_t *dst, gx_surface_t *src)
 	dst->dirty = true; src->dirty = false;
 }
 
-void GXPlanarApplyScan2x(gx_surface_t *dst, gx_surface_t *src, bool field)
+static void GXPlanarStateScan2x(uint32_t field)
 {
 	Mtx44 projection;
 	guOrtho(projection, 0., 1024., 0., 1024., 0., 1.);
@@ -639,6 +679,11 @@ void GXPlanarApplyScan2x(gx_surface_t *dst, gx_surface_t *src, bool field)
 
 	GX_SetPixelFmt(GX_PF_RGB8_Z24, GX_ZC_LINEAR);
 	GX_SetCopyFilter(GX_FALSE, NULL, GX_FALSE, NULL);
+}
+
+void GXPlanarApplyScan2x(gx_surface_t *dst, gx_surface_t *src, bool field)
+{
+	GX_CallDispList(displist.scan2x[field].list, displist.scan2x[field].size);
 
 	if (src->dirty) GX_PreloadEntireTexture(&src->obj[0], &src->region[0]);
 	GX_LoadTexObjPreloaded(&src->obj[0], &src->region[0], GX_TEXMAP0);
@@ -657,4 +702,27 @@ void GXPlanarAllocState(void)
 	GX_InitTexObjFilterMode(&indtexobj[0], GX_NEAR, GX_NEAR);
 	GX_InitTexObjFilterMode(&indtexobj[1], GX_NEAR, GX_NEAR);
 	GX_InitTexObjFilterMode(&indtexobj[2], GX_NEAR, GX_NEAR);
+
+	GXCompileDispList(&displist.apply, GXPlanarState, 0);
+	GXCompileDispList(&displist.blend, GXPlanarStateBlend, 0);
+	GXCompileDispList(&displist.deflicker, GXPlanarStateDeflicker, 0);
+	GXCompileDispList(&displist.scale2xex, GXPlanarStateScale2xEx, 0);
+	GXCompileDispList(&displist.scale2x[0], GXPlanarStateScale2x, false);
+	GXCompileDispList(&displist.scale2x[1], GXPlanarStateScale2x, true);
+	GXCompileDispList(&displist.eagle2x, GXPlanarStateEagle2x, 0);
+	GXCompileDispList(&displist.scan2x[0], GXPlanarStateScan2x, false);
+	GXCompileDispList(&displist.scan2x[1], GXPlanarStateScan2x, true);
+}
+
+void GXPlanarFreeState(void)
+{
+	GXFreeDispList(&displist.apply);
+	GXFreeDispList(&displist.blend);
+	GXFreeDispList(&displist.deflicker);
+	GXFreeDispList(&displist.scale2xex);
+	GXFreeDispList(&displist.scale2x[0]);
+	GXFreeDispList(&displist.scale2x[1]);
+	GXFreeDispList(&displist.eagle2x);
+	GXFreeDispList(&displist.scan2x[0]);
+	GXFreeDispList(&displist.scan2x[1]);
 }
@@ -57,6 +57,26 @@ static uint8_t texdata[][8 * 8] ATTRIBUTE_ALIGN(32) = {
 
 static GXTexObj texobj;
 
+static struct {
+	gx_displist_t rgb[2];
+	gx_displist_t apply;
+	gx_displist_t dither;
+	gx_displist_t dither_fast;
+	gx_displist_t blend[GX_MAX_TEXMAP + 1];
+	gx_displist_t blend_dither[GX_MAX_TEXMAP + 1];
+	gx_displist_t blend_dither_fast[GX_MAX_TEXMAP + 1];
+} displist;
+
+#define ADAPT_DOWN 16
+#define ADAPT_UP   120
+
+static struct {
+	unsigned limit;
+	unsigned factor;
+	unsigned natural;
+	unsigned over, under;
+} adapt;
+
 static uint16_t tlutdata[GX_MAX_TEXMAP][3][256] ATTRIBUTE_ALIGN(32);
 static GXTlutObj tlutobj[GX_MAX_TEXMAP][3];
 
@@ -94,7 +114,127 @@ static void GXPrescaleCopyChannel(GXTexObj texobj, rect_t dst_rect, rect_t src_r
 	GX_CopyTex(ptr, channel == GX_CH_BLUE ? GX_TRUE : GX_FALSE);
 }
 
-void GXPrescaleApply(gx_surface_t *dst, gx_surface_t *src)
+// all three planes are sampled at once, so they need their own TMEM
+static bool GXPrescaleUseRGB(gx_surface_t *dst, gx_surface_t *src)
+{
+	void *ptr;
+	uint16_t width, height;
+	uint8_t format, wrap_s, wrap_t, mipmap;
+
+	GX_GetTexObjAll(&dst->obj[0], &ptr, &width, &height, &format, &wrap_s, &wrap_t, &mipmap);
+
+	return (width << mipmap) <= 640 && (height << mipmap) <= 528 && !src->overlap;
+}
+
+static void GXPrescaleStateRGB(uint32_t dither)
+{
+	Mtx44 projection;
+	guOrtho(projection, 0., 1024., 0., 1024., 0., 1.);
+
+	GX_SetBlendMode(GX_BM_NONE, GX_BL_ZERO, GX_BL_ZERO, GX_LO_CLEAR);
+	GX_SetAlphaCompare(GX_ALWAYS, 0, GX_AOP_AND, GX_ALWAYS, 0);
+	GX_SetZMode(GX_FALSE, GX_ALWAYS, GX_FALSE);
+	GX_SetZCompLoc(GX_FALSE);
+
+	GX_SetNumChans(0);
+	GX_SetNumTexGens(1);
+	GX_SetNumIndStages(0);
+	GX_SetNumTevStages(dither ? 8 : 3);
+
+	GX_SetTexCoordGen(GX_TEXCOORD0, GX_TG_MTX2x4, GX_TG_TEX0, GX_IDENTITY);
+
+	GX_SetTevSwapModeTable(GX_TEV_SWAP0, GX_CH_RED, GX_CH_GREEN, GX_CH_BLUE, GX_CH_ALPHA);
+
+	GX_SetTevKColor(GX_KCOLOR0, (GXColor){4, 4, 4, 4});
+	GX_SetTevKColor(GX_KCOLOR1, (GXColor){255, 0, 0});
+	GX_SetTevKColor(GX_KCOLOR2, (GXColor){0, 255, 0});
+	GX_SetTevKColor(GX_KCOLOR3, (GXColor){0, 0, 255});
+
+	for (int ch = GX_CH_RED; ch <= GX_CH_BLUE; ch++) {
+		GX_SetTevOrder(GX_TEVSTAGE0 + ch, GX_TEXCOORD0, GX_TEXMAP0 + ch, GX_COLOR_NULL);
+		GX_SetTevKColorSel(GX_TEVSTAGE0 + ch, GX_TEV_KCSEL_K1 + ch);
+		GX_SetTevColorIn(GX_TEVSTAGE0 + ch, ch == GX_CH_RED ? GX_CC_ZERO : GX_CC_CPREV, dither ? GX_CC_TEXC : GX_CC_TEXA, GX_CC_KONST, GX_CC_ZERO);
+		GX_SetTevColorOp(GX_TEVSTAGE0 + ch, GX_TEV_ADD, GX_TB_ZERO, GX_CS_SCALE_1, GX_TRUE, GX_TEVPREV);
+		GX_SetTevAlphaIn(GX_TEVSTAGE0 + ch, GX_CA_ZERO, GX_CA_ZERO, GX_CA_ZERO, GX_CA_ZERO);
+		GX_SetTevAlphaOp(GX_TEVSTAGE0 + ch, GX_TEV_ADD, GX_TB_ZERO, GX_CS_SCALE_1, GX_TRUE, GX_TEVPREV);
+		GX_SetTevDirect(GX_TEVSTAGE0 + ch);
+	}
+
+	if (dither) {
+		for (int ch = GX_CH_RED; ch <= GX_CH_BLUE; ch++) {
+			GX_SetTevOrder(GX_TEVSTAGE3 + ch, GX_TEXCOORD0, GX_TEXMAP0 + ch, GX_COLOR_NULL);
+			GX_SetTevKColorSel(GX_TEVSTAGE3 + ch, GX_TEV_KCSEL_K1 + ch);
+			GX_SetTevColorIn(GX_TEVSTAGE3 + ch, ch == GX_CH_RED ? GX_CC_ZERO : GX_CC_C1, GX_CC_TEXA, GX_CC_KONST, GX_CC_ZERO);
+			GX_SetTevColorOp(GX_TEVSTAGE3 + ch, GX_TEV_ADD, GX_TB_ZERO, GX_CS_SCALE_1, GX_TRUE, GX_TEVREG1);
+			GX_SetTevAlphaIn(GX_TEVSTAGE3 + ch, GX_CA_ZERO, GX_CA_ZERO, GX_CA_ZERO, GX_CA_ZERO);
+			GX_SetTevAlphaOp(GX_TEVSTAGE3 + ch, GX_TEV_ADD, GX_TB_ZERO, GX_CS_SCALE_1, GX_TRUE, GX_TEVPREV);
+			GX_SetTevDirect(GX_TEVSTAGE3 + ch);
+		}
+
+		GX_SetTevOrder(GX_TEVSTAGE6, GX_TEXCOORD_NULL, GX_TEXMAP_NULL, GX_COLOR_NULL);
+		GX_SetTevKColorSel(GX_TEVSTAGE6, GX_TEV_KCSEL_1_4);
+		GX_SetTevColorIn(GX_TEVSTAGE6, GX_CC_ZERO, GX_CC_CPREV, GX_CC_KONST, GX_CC_C0);
+		GX_SetTevColorOp(GX_TEVSTAGE6, GX_TEV_ADD, GX_TB_ZERO, GX_CS_SCALE_1, GX_TRUE, GX_TEVPREV);
+		GX_SetTevAlphaIn(GX_TEVSTAGE6, GX_CA_ZERO, GX_CA_ZERO, GX_CA_ZERO, GX_CA_ZERO);
+		GX_SetTevAlphaOp(GX_TEVSTAGE6, GX_TEV_ADD, GX_TB_ZERO, GX_CS_SCALE_1, GX_TRUE, GX_TEVPREV);
+		GX_SetTevDirect(GX_TEVSTAGE6);
+
+		GX_SetTevOrder(GX_TEVSTAGE7, GX_TEXCOORD_NULL, GX_TEXMAP_NULL, GX_COLOR_NULL);
+		GX_SetTevKColorSel(GX_TEVSTAGE7, GX_TEV_KCSEL_K0);
+		GX_SetTevColorIn(GX_TEVSTAGE7, GX_CC_ZERO, GX_CC_CPREV, GX_CC_KONST, GX_CC_C1);
+		GX_SetTevColorOp(GX_TEVSTAGE7, GX_TEV_ADD, GX_TB_ZERO, GX_CS_SCALE_1, GX_TRUE, GX_TEVPREV);
+		GX_SetTevAlphaIn(GX_TEVSTAGE7, GX_CA_ZERO, GX_CA_ZERO, GX_CA_ZERO, GX_CA_ZERO);
+		GX_SetTevAlphaOp(GX_TEVSTAGE7, GX_TEV_ADD, GX_TB_ZERO, GX_CS_SCALE_1, GX_TRUE, GX_TEVPREV);
+		GX_SetTevDirect(GX_TEVSTAGE7);
+	}
+
+	GX_ClearVtxDesc();
+	GX_SetVtxDesc(GX_VA_POS, GX_DIRECT);
+	GX_SetVtxDesc(GX_VA_TEX0, GX_DIRECT);
+	GX_SetVtxAttrFmt(GX_VTXFMT0, GX_VA_POS, GX_POS_XY, GX_S16, 0);
+	GX_SetVtxAttrFmt(GX_VTXFMT0, GX_VA_TEX0, GX_TEX_ST, GX_S16, 0);
+
+	GX_LoadProjectionMtx(projection, GX_ORTHOGRAPHIC);
+	GX_SetCurrentMtx(GX_PNMTX0);
+	GX_SetViewport(0., 0., 1024., 1024., 0., 1.);
+
+	GX_SetFieldMask(GX_TRUE, GX_TRUE);
+	GX_SetFieldMode(GX_FALSE, GX_FALSE);
+
+	GX_SetPixelFmt(GX_PF_RGB8_Z24, GX_ZC_LINEAR);
+	GX_SetCopyFilter(GX_FALSE, NULL, GX_FALSE, NULL);
+}
+
+static void GXPrescaleApplyRGB(gx_surface_t *dst, gx_surface_t *src, bool dither)
+{
+	GX_CallDispList(displist.rgb[dither].list, displist.rgb[dither].size);
+
+	if (dither) {
+		int idx = state.retrace;
+
+		GX_SetTevColorS10(GX_TEVREG0, (GXColorS10){
+			(idx + GX_CH_RED)   % 2 ? -32 : +15,
+			(idx + GX_CH_GREEN) % 2 ? -32 : +15,
+			(idx + GX_CH_BLUE)  % 2 ? -32 : +15
+		});
+	}
+
+	GX_LoadTlut(&src->lutobj[GX_CH_RED],   GX_TLUT0);
+	GX_LoadTlut(&src->lutobj[GX_CH_GREEN], GX_TLUT1);
+	GX_LoadTlut(&src->lutobj[GX_CH_BLUE],  GX_TLUT2);
+
+	for (int ch = GX_CH_RED; ch <= GX_CH_BLUE; ch++) {
+		if (src->dirty) GX_PreloadEntireTexture(&src->obj[ch], &src->region[ch]);
+		GX_LoadTexObjPreloaded(&src->obj[ch], &src->region[ch], GX_TEXMAP0 + ch);
+	}
+
+	for (int ch = GX_CH_RED; ch <= GX_CH_BLUE; ch++)
+		GXPlanarCopyChannel(dst->obj[ch], dst->rect, src->rect, ch);
+
+	dst->dirty = true; src->dirty = false;
+}
+
+static void GXPrescaleState(uint32_t arg)
 {
 	Mtx44 projection;
 	guOrtho(projection, 0., 1024., 0., 1024., 0., 1.);
@@ -131,6 +271,16 @@ void GXPrescaleApply(gx_surface_t *dst, gx_surface_t *src)
 
 	GX_SetPixelFmt(GX_PF_Y8, GX_ZC_LINEAR);
 	GX_SetCopyFilter(GX_FALSE, NULL, GX_FALSE, NULL);
+}
+
+void GXPrescaleApply(gx_surface_t *dst, gx_surface_t *src)
+{
+	if (GXPrescaleUseRGB(dst, src)) {
+		GXPrescaleApplyRGB(dst, src, false);
+		return;
+	}
+
+	GX_CallDispList(displist.apply.list, displist.apply.size);
 
 	GX_LoadTlut(&src->lutobj[GX_CH_RED],   GX_TLUT0);
 	GX_LoadTlut(&src->lutobj[GX_CH_GREEN], GX_TLUT1);
@@ -146,7 +296,7 @@ void GXPrescaleApply(gx_surface_t *dst, gx_surface_t *src)
 	dst->dirty = true; src->dirty = false;
 }
 
-void GXPrescaleApplyDither(gx_surface_t *dst, gx_surface_t *src)
+static void GXPrescaleStateDither(uint32_t arg)
 {
 	Mtx44 projection;
 	guOrtho(projection, 0., 1024., 0., 1024., 0., 1.);
@@ -204,6 +354,11 @@ void GXPrescaleApplyDither(gx_surface_t *dst, gx_surface_t *src)
 
 	GX_SetPixelFmt(GX_PF_Y8, GX_ZC_LINEAR);
 	GX_SetCopyFilter(GX_FALSE, NULL, GX_FALSE, NULL);
+}
+
+void GXPrescaleApplyDither(gx_surface_t *dst, gx_surface_t *src)
+{
+	GX_CallDispList(displist.dither.list, displist.dither.size);
 
 	GX_LoadTlut(&src->lutobj[GX_CH_RED],   GX_TLUT0);
 	GX_LoadTlut(&src->lutobj[GX_CH_GREEN], GX_TLUT1);
@@ -221,7 +376,7 @@ void GXPrescaleApplyDither(gx_surface_t *dst, gx_surface_t *src)
 	dst->dirty = true; src->dirty = false;
 }
 
-void GXPrescaleApplyDitherFast(gx_surface_t *dst, gx_surface_t *src)
+static void GXPrescaleStateDitherFast(uint32_t arg)
 {
 	Mtx44 projection;
 	guOrtho(projection, 0., 1024., 0., 1024., 0., 1.);
@@ -285,6 +440,16 @@ void GXPrescaleApplyDitherFast(gx_surface_t *dst, gx_surface_t *src)
 
 	GX_SetPixelFmt(GX_PF_Y8, GX_ZC_LINEAR);
 	GX_SetCopyFilter(GX_FALSE, NULL, GX_FALSE, NULL);
+}
+
+void GXPrescaleApplyDitherFast(gx_surface_t *dst, gx_surface_t *src)
+{
+	if (state.dither == DITHER_THRESHOLD && GXPrescaleUseRGB(dst, src)) {
+		GXPrescaleApplyRGB(dst, src, true);
+		return;
+	}
+
+	GX_CallDispList(displist.dither_fast.list, displist.dither_fast.size);
 
 	GX_LoadTlut(&src->lutobj[GX_CH_RED],   GX_TLUT0);
 	GX_LoadTlut(&src->lutobj[GX_CH_GREEN], GX_TLUT1);
@@ -310,7 +475,7 @@ void GXPrescaleApplyDitherFast(gx_surface_t *dst, gx_surface_t *src)
 	dst->dirty = true; src->dirty = false;
 }
 
-void GXPrescaleApplyBlend(gx_surface_t *dst, gx_surface_t **src, uint8_t *alpha, uint32_t count)
+static void GXPrescaleStateBlend(uint32_t count)
 {
 	Mtx44 projection;
 	guOrtho(projection, 0., 1024., 0., 1024., 0., 1.);
@@ -327,11 +492,6 @@ void GXPrescaleApplyBlend(gx_surface_t *dst, gx_surface_t **src, uint8_t *alpha,
 
 	GX_SetTevSwapModeTable(GX_TEV_SWAP0, GX_CH_RED, GX_CH_GREEN, GX_CH_BLUE, GX_CH_ALPHA);
 
-	GX_SetTevKColor(GX_KCOLOR0, (GXColor){alpha[0], alpha[4]});
-	GX_SetTevKColor(GX_KCOLOR1, (GXColor){alpha[1], alpha[5]});
-	GX_SetTevKColor(GX_KCOLOR2, (GXColor){alpha[2], alpha[6]});
-	GX_SetTevKColor(GX_KCOLOR3, (GXColor){alpha[3], alpha[7]});
-
 	for (int i = 0; i < count; i++) {
 		GX_SetTevOrder(GX_TEVSTAGE0 + i, GX_TEXCOORD0, GX_TEXMAP0 + i, GX_COLOR_NULL);
 		GX_SetTevKColorSel(GX_TEVSTAGE0 + i, GX_TEV_KCSEL_K0_R + i);
@@ -355,6 +515,16 @@ void GXPrescaleApplyBlend(gx_surface_t *dst, gx_surface_t **src, uint8_t *alpha,
 
 	GX_SetPixelFmt(GX_PF_Y8, GX_ZC_LINEAR);
 	GX_SetCopyFilter(GX_FALSE, NULL, GX_FALSE, NULL);
+}
+
+void GXPrescaleApplyBlend(gx_surface_t *dst, gx_surface_t **src, uint8_t *alpha, uint32_t count)
+{
+	GX_CallDispList(displist.blend[count].list, displist.blend[count].size);
+
+	GX_SetTevKColor(GX_KCOLOR0, (GXColor){alpha[0], alpha[4]});
+	GX_SetTevKColor(GX_KCOLOR1, (GXColor){alpha[1], alpha[5]});
+	GX_SetTevKColor(GX_KCOLOR2, (GXColor){alpha[2], alpha[6]});
+	GX_SetTevKColor(GX_KCOLOR3, (GXColor){alpha[3], alpha[7]});
 
 	for (int ch = GX_CH_RED; ch <= GX_CH_BLUE; ch++) {
 		for (int i = 0; i < count; i++) {
@@ -413,10 +583,8 @@ static void GXPrescaleTlut(gx_surface_t **surfaces, uint8_t *alpha, uint32_t cou
 	DCStoreRange(tlutdata, sizeof(tlutdata[0]) * count);
 }
 
-void GXPrescaleApplyBlendDither(gx_surface_t *dst, gx_surface_t **src, uint8_t *alpha, uint32_t count)
+static void GXPrescaleStateBlendDither(uint32_t count)
 {
-	count = MIN(count, 7);
-
 	Mtx44 projection;
 	guOrtho(projection, 0., 1024., 0., 1024., 0., 1.);
 
@@ -475,6 +643,13 @@ void GXPrescaleApplyBlendDither(gx_surface_t *dst, gx_surface_t **src, uint8_t *
 
 	GX_SetPixelFmt(GX_PF_Y8, GX_ZC_LINEAR);
 	GX_SetCopyFilter(GX_FALSE, NULL, GX_FALSE, NULL);
+}
+
+void GXPrescaleApplyBlendDither(gx_surface_t *dst, gx_surface_t **src, uint8_t *alpha, uint32_t count)
+{
+	count = MIN(count, 7);
+
+	GX_CallDispList(displist.blend_dither[count].list, displist.blend_dither[count].size);
 
 	GXPrescaleTlut(src, alpha, count);
 
@@ -492,7 +667,7 @@ void GXPrescaleApplyBlendDither(gx_surface_t *dst, gx_surface_t **src, uint8_t *
 	dst->dirty = true; src[0]->dirty = false;
 }
 
-void GXPrescaleApplyBlendDitherFast(gx_surface_t *dst, gx_surface_t **src, uint8_t *alpha, uint32_t count)
+static void GXPrescaleStateBlendDitherFast(uint32_t count)
 {
 	Mtx44 projection;
 	guOrtho(projection, 0., 1024., 0., 1024., 0., 1.);
@@ -558,6 +733,11 @@ void GXPrescaleApplyBlendDitherFast(gx_surface_t *dst, gx_surface_t **src, uint8
 
 	GX_SetPixelFmt(GX_PF_Y8, GX_ZC_LINEAR);
 	GX_SetCopyFilter(GX_FALSE, NULL, GX_FALSE, NULL);
+}
+
+void GXPrescaleApplyBlendDitherFast(gx_surface_t *dst, gx_surface_t **src, uint8_t *alpha, uint32_t count)
+{
+	GX_CallDispList(displist.blend_dither_fast[count].list, displist.blend_dither_fast[count].size);
 
 	GXPrescaleTlut(src, alpha, count);
 
@@ -613,6 +793,34 @@ void GXPrescaleAllocState(void)
 	for (int i = GX_TEXMAP0; i < GX_MAX_TEXMAP; i++)
 		for (int ch = GX_CH_RED; ch <= GX_CH_BLUE; ch++)
 			GX_InitTlutObj(&tlutobj[i][ch], tlutdata[i][ch], GX_TL_IA8, 256);
+
+	GXCompileDispList(&displist.rgb[0], GXPrescaleStateRGB, false);
+	GXCompileDispList(&displist.rgb[1], GXPrescaleStateRGB, true);
+	GXCompileDispList(&displist.apply, GXPrescaleState, 0);
+	GXCompileDispList(&displist.dither, GXPrescaleStateDither, 0);
+	GXCompileDispList(&displist.dither_fast, GXPrescaleStateDitherFast, 0);
+
+	for (int i = 1; i <= GX_MAX_TEXMAP; i++) {
+		GXCompileDispList(&displist.blend[i], GXPrescaleStateBlend, i);
+		GXCompileDispList(&displist.blend_dither_fast[i], GXPrescaleStateBlendDitherFast, i);
+		if (i < GX_MAX_TEXMAP)
+			GXCompileDispList(&displist.blend_dither[i], GXPrescaleStateBlendDither, i);
+	}
+}
+
+void GXPrescaleFreeState(void)
+{
+	GXFreeDispList(&displist.rgb[0]);
+	GXFreeDispList(&displist.rgb[1]);
+	GXFreeDispList(&displist.apply);
+	GXFreeDispList(&displist.dither);
+	GXFreeDispList(&displist.dither_fast);
+
+	for (int i = 1; i <= GX_MAX_TEXMAP; i++) {
+		GXFreeDispList(&displist.blend[i]);
+		GXFreeDispList(&displist.blend_dither[i]);
+		GXFreeDispList(&displist.blend_dither_fast[i]);
+	}
 }
 
 rect_t GXPrescaleGetRect(uint16_t width, uint16_t height)
@@ -626,10 +834,56 @@ rect_t GXPrescaleGetRect(uint16_t width, uint16_t height)
 	int X = lrintf(x * fabsf(cosf(r)) + x * fabsf(sinf(r)));
 	int Y = lrintf(y * fabsf(cosf(r)) + y * fabsf(sinf(r)));
 
+	X = MIN(MAX(X, 1), 1024 / width);
+	Y = MIN(MAX(Y, 1),  640 / height);
+
+	adapt.natural = MAX(X, Y);
+
+	if (adapt.limit) {
+		X = MIN(X, adapt.limit);
+		Y = MIN(Y, adapt.limit);
+	}
+
+	adapt.factor = MAX(X, Y);
+
 	rect.x = 0;
 	rect.y = 0;
-	rect.w = width  * MIN(MAX(X, 1), 1024 / width);
-	rect.h = height * MIN(MAX(Y, 1),  640 / height);
+	rect.w = width  * X;
+	rect.h = height * Y;
 
 	return rect;
 }
+
+void GXPrescaleAdapt(uint64_t gx, uint64_t period)
+{
+	uint64_t target = period * state.prescale_budget / 100;
+	unsigned factor = adapt.factor;
+
+	if (!factor || !target)
+		return;
+
+	if (gx > target) {
+		adapt.under = 0;
+
+		if (++adapt.over >= ADAPT_DOWN && factor > 1) {
+			adapt.limit = factor - 1;
+			adapt.over = 0;
+		}
+	} else if (adapt.limit && gx * (factor + 1) * (factor + 1) < target * factor * factor) {
+		adapt.over = 0;
+
+		if (++adapt.under >= ADAPT_UP) {
+			if (++adapt.limit >= adapt.natural)
+				adapt.limit = 0;
+			adapt.under = 0;
+		}
+	} else {
+		adapt.over = 0;
+		adapt.under = 0;
+	}
+}
+
+unsigned GXPrescaleGetFactor(void)
+{
+	return adapt.factor;
+}
@@ -0,0 +1,312 @@
+/* 
+ * Copyright (c) 2015-2025, Extrems' Corner.org
+ * 
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gccore.h>
+#include <ogc/lwp_watchdog.h>
+#include "gba.h"
+#include "gx.h"
+#include "state.h"
+#include "util.h"
+
+static uint16_t width, height;
+static uint16_t *history[2];
+static uint8_t *accumulator;
+static uint16_t *converted;
+
+static struct {
+	uint32_t frames;
+	uint32_t pixels;
+	uint32_t mismatch;
+	uint32_t convert;
+	uint8_t error;
+	uint64_t ticks;
+} stats;
+
+static const char *names[FILTER_MAX] = {
+	[FILTER_NONE]        = "none",
+	[FILTER_BLEND]       = "blend",
+	[FILTER_DEFLICKER]   = "deflicker",
+	[FILTER_ACCUMULATE]  = "accumulate",
+	[FILTER_SCALE2XEX]   = "scale2xex",
+	[FILTER_SCALE2XPLUS] = "scale2xplus",
+	[FILTER_SCALE2X]     = "scale2x",
+	[FILTER_EAGLE2X]     = "eagle2x",
+	[FILTER_SCAN2X]      = "scan2x",
+	[FILTER_NORMAL2X]    = "normal2x",
+};
+
+static inline uint8_t expand5(uint16_t value)
+{
+	value &= 0x1F;
+	return value << 3 | value >> 2;
+}
+
+static inline void unpack(uint16_t pixel, int rgb[3])
+{
+	rgb[0] = expand5(pixel);
+	rgb[1] = expand5(pixel >> 5);
+	rgb[2] = expand5(pixel >> 10);
+}
+
+static inline int lerp(int a, int b, int c)
+{
+	c += c >> 7;
+	return ((a << 8) + (b - a) * c + 128) >> 8;
+}
+
+static inline uint16_t fetch(const uint16_t *src, int x, int y)
+{
+	x = x < 0 ? 0 : x < width  ? x : width  - 1;
+	y = y < 0 ? 0 : y < height ? y : height - 1;
+	return src[y * width + x] & 0x7FFF;
+}
+
+static inline void store(gx_surface_t *dst, uint32_t stride, int x, int y, const int rgb[3])
+{
+	uint32_t offset = ((y >> 2) * stride + (x >> 3)) * 32 + (y & 3) * 8 + (x & 7);
+
+	((uint8_t *)dst->buf[GX_CH_RED  ])[offset] = rgb[0];
+	((uint8_t *)dst->buf[GX_CH_GREEN])[offset] = rgb[1];
+	((uint8_t *)dst->buf[GX_CH_BLUE ])[offset] = rgb[2];
+}
+
+static inline void yuv(uint16_t pixel, int out[3])
+{
+	int rgb[3];
+	unpack(pixel, rgb);
+
+	out[0] = ((112 * rgb[0] -  94 * rgb[1] -  18 * rgb[2] + 128) >> 8) + 128;
+	out[1] = ((-38 * rgb[0] -  74 * rgb[1] + 112 * rgb[2] + 128) >> 8) + 128;
+	out[2] = (( 66 * rgb[0] + 129 * rgb[1] +  25 * rgb[2] + 128) >> 8) +  16;
+}
+
+static inline int differ(const int a[3], const int b[3], int ch)
+{
+	static const int threshold[3] = {13, 13, 23};
+	return ((a[ch] - b[ch] + threshold[ch]) & 0xFF) > threshold[ch] * 2;
+}
+
+static void apply_scale1(gx_surface_t *dst, uint32_t stride, const uint16_t *src)
+{
+	uint8_t weight[3] = {
+		state.filter_weight[0] * 255. + .5,
+		state.filter_weight[1] * 255. + .5,
+		state.filter_weight[2] * 255. + .5
+	};
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			int rgb[3], prev[3];
+			uint16_t pixel = fetch(src, x, y);
+
+			unpack(pixel, rgb);
+
+			switch (state.filter) {
+				case FILTER_BLEND:
+					unpack(fetch(history[0], x, y), prev);
+
+					for (int ch = 0; ch < 3; ch++)
+						rgb[ch] = lerp(prev[ch], rgb[ch], weight[ch]);
+					break;
+				case FILTER_DEFLICKER:
+					if (fetch(history[1], x, y) != pixel)
+						break;
+
+					unpack(fetch(history[0], x, y), prev);
+
+					for (int ch = 0; ch < 3; ch++)
+						rgb[ch] = lerp(prev[ch], rgb[ch], weight[ch]);
+					break;
+				case FILTER_ACCUMULATE:
+					for (int ch = 0; ch < 3; ch++) {
+						uint8_t *acc = &accumulator[(ch * height + y) * width + x];
+						rgb[ch] = *acc = lerp(rgb[ch], *acc, weight[ch]);
+					}
+					break;
+			}
+
+			store(dst, stride, x, y, rgb);
+		}
+	}
+}
+
+static void apply_scale2(gx_surface_t *dst, uint32_t stride, const uint16_t *src)
+{
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			uint16_t A = fetch(src, x - 1, y - 1), B = fetch(src, x, y - 1), C = fetch(src, x + 1, y - 1);
+			uint16_t D = fetch(src, x - 1, y    ), E = fetch(src, x, y    ), F = fetch(src, x + 1, y    );
+			uint16_t G = fetch(src, x - 1, y + 1), H = fetch(src, x, y + 1), I = fetch(src, x + 1, y + 1);
+
+			for (int dy = 0; dy < 2; dy++) {
+				for (int dx = 0; dx < 2; dx++) {
+					uint16_t V = dy ? H : B;
+					uint16_t S = dx ? F : D;
+					uint16_t X = dy ? (dx ? I : G) : (dx ? C : A);
+					int rgb[3], tmp[3];
+
+					unpack(E, rgb);
+
+					switch (state.filter) {
+						case FILTER_SCALE2XEX:
+						{
+							int yuvB[3], yuvD[3], yuvE[3], yuvF[3], yuvH[3], yuvS[3], yuvV[3];
+							bool edge = false, similar = true;
+
+							yuv(B, yuvB); yuv(D, yuvD); yuv(E, yuvE);
+							yuv(F, yuvF); yuv(H, yuvH);
+							yuv(S, yuvS); yuv(V, yuvV);
+
+							for (int ch = 0; ch < 3; ch++) {
+								edge |= differ(yuvB, yuvH, ch) && differ(yuvD, yuvF, ch);
+								similar &= !differ(yuvV, yuvS, ch);
+							}
+
+							if (edge && similar) {
+								unpack(V, tmp);
+
+								for (int ch = 0; ch < 3; ch++) {
+									int mix = (tmp[ch] + expand5(S >> ch * 5)) >> 1;
+									rgb[ch] = (mix * 127 + rgb[ch] * 128 + 127) / 255;
+								}
+							}
+							break;
+						}
+						case FILTER_SCALE2XPLUS:
+							if (B != H && D != F && V == S) {
+								unpack(V, tmp);
+
+								for (int ch = 0; ch < 3; ch++)
+									rgb[ch] = (rgb[ch] + tmp[ch]) >> 1;
+							}
+							break;
+						case FILTER_SCALE2X:
+							if (B != H && D != F && V == S)
+								unpack(V, rgb);
+							break;
+						case FILTER_EAGLE2X:
+							if (V == S && S == X)
+								unpack(V, rgb);
+							break;
+						case FILTER_SCAN2X:
+							if (!dy)
+								rgb[0] = rgb[1] = rgb[2] = 0;
+							break;
+					}
+
+					store(dst, stride, x * 2 + dx, y * 2 + dy, rgb);
+				}
+			}
+		}
+	}
+}
+
+void GXReferenceAlloc(uint16_t w, uint16_t h)
+{
+	width = w;
+	height = h;
+
+	history[0] = calloc(width * height, sizeof(uint16_t));
+	history[1] = calloc(width * height, sizeof(uint16_t));
+	accumulator = calloc(width * height, 3);
+	converted = GXAllocBuffer(width * height * sizeof(uint16_t));
+
+	memset(&stats, 0, sizeof(stats));
+}
+
+void GXReferenceFree(void)
+{
+	free(history[0]);
+	free(history[1]);
+	free(accumulator);
+	free(converted);
+
+	history[0] = NULL;
+	history[1] = NULL;
+	accumulator = NULL;
+	converted = NULL;
+}
+
+void GXReferenceApply(gx_surface_t *dst, const uint16_t *src)
+{
+	uint32_t stride = (GX_GetTexObjWidth(&dst->obj[0]) + 7) >> 3;
+
+	switch (state.filter) {
+		case FILTER_SCALE2XEX:
+		case FILTER_SCALE2XPLUS:
+		case FILTER_SCALE2X:
+		case FILTER_EAGLE2X:
+		case FILTER_SCAN2X:
+		case FILTER_NORMAL2X:
+			apply_scale2(dst, stride, src);
+			break;
+		default:
+			apply_scale1(dst, stride, src);
+	}
+
+	SWAP(history[0], history[1]);
+	memcpy(history[0], src, width * height * sizeof(uint16_t));
+}
+
+uint32_t GXReferenceCompare(gx_surface_t *ref, gx_surface_t *out, uint8_t *error)
+{
+	uint32_t mismatch = 0;
+
+	*error = 0;
+
+	for (int i = 0; i < out->planes; i++) {
+		uint8_t *a = ref->buf[i];
+		uint8_t *b = out->buf[i];
+
+		DCInvalidateRange(b, out->size);
+
+		for (int j = 0; j < out->size; j++) {
+			if (a[j] != b[j]) {
+				uint8_t diff = abs(a[j] - b[j]);
+				if (*error < diff) *error = diff;
+				mismatch++;
+			}
+		}
+	}
+
+	return mismatch;
+}
+
+void GXReferenceVerify(gx_surface_t *ref, gx_surface_t *out, gx_surface_t *conv, const uint16_t *src)
+{
+	uint64_t start = gettime();
+	uint8_t error;
+
+	GXReferenceApply(ref, src);
+
+	stats.ticks += diff_ticks(start, gettime());
+	stats.pixels += out->rect.w * out->rect.h;
+	stats.frames++;
+
+	GX_DrawDone();
+
+	stats.mismatch += GXReferenceCompare(ref, out, &error);
+	if (stats.error < error) stats.error = error;
+
+	GBAVideoConvertBGR5Mem(converted, (void *)src, width, height);
+	DCInvalidateRange(*conv->buf, conv->size);
+
+	for (int i = 0; i < width * height; i++)
+		stats.convert += converted[i] != ((uint16_t *)*conv->buf)[i];
+
+	if (stats.ticks >= secs_to_ticks(1)) {
+		printf("reference %s: %u frames, %u mismatched texels, max error %u, %u mismatched pixels, %.2f Mpixel/s\n",
+			names[state.filter], stats.frames, stats.mismatch, stats.error, stats.convert,
+			stats.pixels / (ticks_to_microsecs(stats.ticks) + 1.));
+		memset(&stats, 0, sizeof(stats));
+	}
+}
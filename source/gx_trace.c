@@ -0,0 +1,255 @@
+/* 
+ * Copyright (c) 2015-2025, Extrems' Corner.org
+ * 
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <gccore.h>
+#include <ogc/lwp_watchdog.h>
+#include "gx.h"
+
+#ifdef HW_RVL
+#define PI_FIFO_MASK 0x1FFFFFE0
+#else
+#define PI_FIFO_MASK 0x03FFFFE0
+#endif
+
+#define PROFILE_TOKEN  0x8000
+#define PROFILE_WINDOW 60
+
+static vu32 *const _piReg = (uint32_t *)0xCC003000;
+
+static FILE *fp;
+static uint32_t frame;
+
+static struct {
+	uint32_t calls;
+	uint32_t bytes;
+	uint32_t wrptr;
+	uint64_t ticks;
+	uint64_t time;
+} trace[GX_PASS_MAX];
+
+static struct {
+	bool active;
+	int pass;
+	uint64_t time;
+	uint32_t frames;
+	struct {
+		uint32_t calls;
+		uint64_t ticks;
+		uint64_t min, max;
+	} window[GX_PASS_MAX];
+	gx_profile_t stats[GX_PASS_MAX];
+} profile;
+
+static const char *names[GX_PASS_MAX] = {
+	[GX_PASS_CONVERT]  = "convert",
+	[GX_PASS_PLANAR]   = "planar",
+	[GX_PASS_PRESCALE] = "prescale",
+	[GX_PASS_PREVIEW]  = "preview",
+	[GX_PASS_OVERLAY]  = "overlay",
+	[GX_PASS_FONT]     = "font",
+	[GX_PASS_CURSOR]   = "cursor",
+	[GX_PASS_COPY]     = "copy",
+};
+
+static uint32_t fifo_distance(uint32_t start, uint32_t end)
+{
+	uint32_t base = _piReg[3] & PI_FIFO_MASK;
+	uint32_t size = (_piReg[4] & PI_FIFO_MASK) - base + 32;
+
+	start &= PI_FIFO_MASK;
+	end   &= PI_FIFO_MASK;
+
+	return end >= start ? end - start : end - start + size;
+}
+
+bool GXTraceOpen(const char *file)
+{
+	if (fp || !file)
+		return false;
+	if (!(fp = fopen(file, "w")))
+		return false;
+
+	fputs("frame", fp);
+
+	for (int pass = 0; pass < GX_PASS_MAX; pass++)
+		fprintf(fp, ",%s_calls,%s_bytes,%s_us", names[pass], names[pass], names[pass]);
+
+	fputc('\n', fp);
+
+	frame = 0;
+	memset(trace, 0, sizeof(trace));
+	return true;
+}
+
+void GXTraceClose(void)
+{
+	if (fp) {
+		fclose(fp);
+		fp = NULL;
+	}
+}
+
+void GXTraceBegin(int pass)
+{
+	if (profile.active && pass != GX_PASS_CONVERT)
+		GX_SetDrawSync(PROFILE_TOKEN | pass);
+
+	if (!fp)
+		return;
+
+	trace[pass].wrptr = _piReg[5];
+	trace[pass].time  = __SYS_GetSystemTime();
+}
+
+void GXTraceEnd(int pass)
+{
+	if (!fp)
+		return;
+
+	trace[pass].calls++;
+	trace[pass].bytes += fifo_distance(trace[pass].wrptr, _piReg[5]);
+	trace[pass].ticks += diff_ticks(trace[pass].time, __SYS_GetSystemTime());
+}
+
+void GXTraceAddBytes(int pass, uint32_t bytes)
+{
+	if (!fp)
+		return;
+
+	trace[pass].bytes += bytes;
+}
+
+void GXTraceFrame(void)
+{
+	if (!fp)
+		return;
+
+	fprintf(fp, "%u", frame++);
+
+	for (int pass = 0; pass < GX_PASS_MAX; pass++) {
+		fprintf(fp, ",%u,%u,%u", trace[pass].calls, trace[pass].bytes, (uint32_t)ticks_to_microsecs(trace[pass].ticks));
+
+		trace[pass].calls = 0;
+		trace[pass].bytes = 0;
+		trace[pass].ticks = 0;
+	}
+
+	fputc('\n', fp);
+}
+
+const char *GXTraceName(int pass)
+{
+	return names[pass];
+}
+
+static void profile_mark(int pass)
+{
+	uint64_t now = __SYS_GetSystemTime();
+
+	if (profile.pass >= 0) {
+		profile.window[profile.pass].calls++;
+		profile.window[profile.pass].ticks += diff_ticks(profile.time, now);
+	}
+
+	profile.pass = pass;
+	profile.time = now;
+}
+
+void GXProfileStart(void)
+{
+	memset(&profile, 0, sizeof(profile));
+
+	for (int pass = 0; pass < GX_PASS_MAX; pass++)
+		profile.window[pass].min = UINT64_MAX;
+
+	profile.pass = -1;
+	profile.active = true;
+}
+
+void GXProfileStop(const char *file)
+{
+	FILE *out;
+
+	if (!profile.active)
+		return;
+
+	profile.active = false;
+
+	if (!file)
+		return;
+	if (strcmp(file, "-") == 0)
+		out = stdout;
+	else if (!(out = fopen(file, "w")))
+		return;
+
+	fputs("pass,min_us,avg_us,max_us\n", out);
+
+	for (int pass = GX_PASS_PLANAR; pass < GX_PASS_MAX; pass++)
+		fprintf(out, "%s,%u,%u,%u\n", names[pass],
+			(uint32_t)ticks_to_microsecs(profile.stats[pass].min),
+			(uint32_t)ticks_to_microsecs(profile.stats[pass].avg),
+			(uint32_t)ticks_to_microsecs(profile.stats[pass].max));
+
+	if (out != stdout)
+		fclose(out);
+}
+
+bool GXProfileToken(uint16_t token)
+{
+	if (!(token & PROFILE_TOKEN))
+		return false;
+
+	if (profile.active)
+		profile_mark(token & ~PROFILE_TOKEN);
+	return true;
+}
+
+void GXProfileFrame(void)
+{
+	if (!profile.active)
+		return;
+
+	profile_mark(-1);
+
+	for (int pass = 0; pass < GX_PASS_MAX; pass++) {
+		gx_profile_t *stats = &profile.stats[pass];
+		uint64_t ticks = profile.window[pass].ticks;
+
+		if (!profile.window[pass].calls)
+			continue;
+
+		stats->avg = stats->avg ? stats->avg + ((int64_t)(ticks - stats->avg) >> 4) : ticks;
+
+		if (profile.window[pass].min > ticks)
+			profile.window[pass].min = ticks;
+		if (profile.window[pass].max < ticks)
+			profile.window[pass].max = ticks;
+
+		profile.window[pass].calls = 0;
+		profile.window[pass].ticks = 0;
+	}
+
+	if (++profile.frames % PROFILE_WINDOW == 0) {
+		for (int pass = 0; pass < GX_PASS_MAX; pass++) {
+			if (profile.window[pass].min <= profile.window[pass].max) {
+				profile.stats[pass].min = profile.window[pass].min;
+				profile.stats[pass].max = profile.window[pass].max;
+			}
+
+			profile.window[pass].min = UINT64_MAX;
+			profile.window[pass].max = 0;
+		}
+	}
+}
+
+const gx_profile_t *GXProfileGet(int pass)
+{
+	return &profile.stats[pass];
+}
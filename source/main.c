@@ -10,6 +10,7 @@
 #include <sys/stat.h>
 #include <sys/unistd.h>
 #include <stdlib.h>
+#include <malloc.h>
 #include <string.h>
 #include <getopt.h>
 #include <math.h>
@@ -20,16 +21,20 @@
 #include <wiiuse/wpad.h>
 #include <fat.h>
 #include "3ds.h"
+#include "audio.h"
 #include "clock.h"
 #include "gba.h"
 #include "gbp.h"
 #include "gx.h"
 #include "input.h"
 #include "network.h"
+#include "pacing.h"
 #include "state.h"
 #include "sysconf.h"
+#include "util.h"
 #include "video.h"
 #include "wiiload.h"
+#include "vm/vm.h"
 
 #include <mgba/flags.h>
 
@@ -46,6 +51,8 @@ static uint32_t dispsize[4];
 
 static gx_surface_t convert_surface, packed_surface;
 static gx_surface_t planar_surface, prescale_surface;
+static gx_surface_t reference_surface;
+static gx_arena_t surface_arena;
 
 state_t default_state, state = {
 	.draw_osd       = true,
@@ -83,31 +90,39 @@ static void asndlib_cb(void)
 	ClockTick(&aiclock, 1024);
 }
 
-static sem_t semaphore[2] = { LWP_SEM_NULL, LWP_SEM_NULL };
-static syswd_t watchdog = SYS_WD_NULL;
+static struct {
+	uint64_t ready[3];
+	uint64_t frame;
+	uint64_t draw;
+	uint32_t us;
+} latency;
 
-static void alarm_cb(syswd_t alarm, void *arg)
-{
-	LWP_SemPost(semaphore[0]);
-}
-
-static void vsync_cb(uint32_t retrace)
-{
-	LWP_SemPost(semaphore[0]);
-}
+static struct {
+	uint64_t start;
+	uint64_t load;
+	uint64_t frame;
+} romLoad;
 
 static void drawsync_cb(uint16_t token)
 {
+	if (PacingToken(token) || GXProfileToken(token))
+		return;
+
+	GXProfileFrame();
 	VideoSetFramebuffer(token);
+	latency.us = ticks_to_microsecs(diff_ticks(latency.ready[token % ARRAY_ELEMS(latency.ready)], gettime()));
 	//ClockTick(&gxclock, 1);
-	LWP_SemPost(semaphore[1]);
+	PacingDrawDone();
 }
 
 static void _drawStart(void)
 {
-	if (state.draw_wait)
-		LWP_SemWait(semaphore[0]);
-	LWP_SemWait(semaphore[1]);
+	#ifdef HW_DOL
+	// write back dirty VM pages while waiting for the next frame
+	VM_Clean(16);
+	#endif
+
+	PacingWait();
 
 	state.retrace = VIDEO_GetRetraceCount();
 	state.field   = rmode.field_rendering ? VIDEO_GetNextField() : VI_FRAME;
@@ -153,25 +168,39 @@ static void _drawEnd(void)
 			GX_ClearBoundingBox();
 
 			if (dispsize[0]) {
+				GXTraceBegin(GX_PASS_PREVIEW);
 				GXPreviewSetState(state.reset);
 				GX_CallDispList(displist[0], dispsize[0]);
+				GXTraceAddBytes(GX_PASS_PREVIEW, dispsize[0]);
+				GXTraceEnd(GX_PASS_PREVIEW);
 			}
 
 			if (dispsize[1]) {
+				GXTraceBegin(GX_PASS_OVERLAY);
 				GXOverlaySetState();
 				GX_CallDispList(displist[1], dispsize[1]);
+				GXTraceAddBytes(GX_PASS_OVERLAY, dispsize[1]);
+				GXTraceEnd(GX_PASS_OVERLAY);
 			}
 
 			if (dispsize[2]) {
+				GXTraceBegin(GX_PASS_FONT);
 				GXFontSetState();
 				GX_CallDispList(displist[2], dispsize[2]);
+				GXTraceAddBytes(GX_PASS_FONT, dispsize[2]);
+				GXTraceEnd(GX_PASS_FONT);
 			}
 
 			if (dispsize[3]) {
+				GXTraceBegin(GX_PASS_CURSOR);
 				GXCursorSetState();
 				GX_CallDispList(displist[3], dispsize[3]);
+				GXTraceAddBytes(GX_PASS_CURSOR, dispsize[3]);
+				GXTraceEnd(GX_PASS_CURSOR);
 			}
 
+			GXTraceBegin(GX_PASS_COPY);
+
 			GX_SetDispCopyFrame2Field(GX_COPY_PROGRESSIVE);
 			GX_SetDispCopySrc(0, 2, efbWidth, rmode.efbHeight);
 			GX_SetDispCopyDst(rmode.fbWidth, rmode.efbHeight);
@@ -189,11 +218,19 @@ static void _drawEnd(void)
 			GX_SetDispCopyDst(0, 0);
 
 			GX_CopyDisp(&xfb[y][x], GX_TRUE);
+
+			GXTraceEnd(GX_PASS_COPY);
 		}
 	}
 
+	latency.ready[xfb_index % ARRAY_ELEMS(latency.ready)] = latency.frame;
+
+	PacingSubmit();
+
 	GX_SetDrawSyncCallback(drawsync_cb);
 	GX_SetDrawSync(xfb_index);
+
+	GXTraceFrame();
 }
 
 static bool _pollRunning(void)
@@ -378,8 +415,79 @@ static void _guiPrepare(void)
 	GX_LoadPosMtxImm(viewmodel, GX_PNMTX1);
 }
 
+static struct {
+	void *state;
+	struct mStereoSample *audio;
+	size_t samples;
+	bool active;
+	uint64_t save, load;
+} runAhead;
+
+static const struct GUIFont *guiFont;
+
 static void _guiFinish(void)
 {
+	if (state.draw_latency && !state.draw_osd && guiFont) {
+		GUIFontPrintf(guiFont, 0, GUIFontHeight(guiFont) * 2, GUI_ALIGN_LEFT, 0x7FFFFFFF, "%u.%02u ms", latency.us / 1000, latency.us % 1000 / 10);
+		GUIFontPrintf(guiFont, 0, GUIFontHeight(guiFont) * 3, GUI_ALIGN_LEFT, 0x7FFFFFFF, "emu %u gx %u wait %u draw %u us, %u missed",
+			(uint32_t)ticks_to_microsecs(pacing_stats.average.emulate),
+			(uint32_t)ticks_to_microsecs(pacing_stats.average.gx),
+			(uint32_t)ticks_to_microsecs(pacing_stats.average.wait),
+			(uint32_t)ticks_to_microsecs(latency.draw),
+			pacing_stats.missed);
+
+		if (state.run_ahead)
+			GUIFontPrintf(guiFont, 0, GUIFontHeight(guiFont) * 4, GUI_ALIGN_LEFT, 0x7FFFFFFF, "run-ahead %u, save %u load %u us",
+				state.run_ahead,
+				(uint32_t)ticks_to_microsecs(runAhead.save),
+				(uint32_t)ticks_to_microsecs(runAhead.load));
+
+		GUIFontPrintf(guiFont, 0, GUIFontHeight(guiFont) * 5, GUI_ALIGN_LEFT, 0x7FFFFFFF, "audio %u, %u underruns, %u overruns",
+			AudioLevel(), audio_stats.underruns, audio_stats.overruns);
+
+		if (state.filter_prescale)
+			GUIFontPrintf(guiFont, 0, GUIFontHeight(guiFont) * 9, GUI_ALIGN_LEFT, 0x7FFFFFFF, "prescale %ux, gx %u.%02u ms",
+				GXPrescaleGetFactor(),
+				(uint32_t)ticks_to_microsecs(pacing_stats.average.draw) / 1000,
+				(uint32_t)ticks_to_microsecs(pacing_stats.average.draw) % 1000 / 10);
+
+		if (state.gx_profile) {
+			uint64_t period = secs_to_ticks(1) / viclock.hz;
+
+			for (int pass = GX_PASS_PLANAR; pass < GX_PASS_MAX; pass++) {
+				const gx_profile_t *profile = GXProfileGet(pass);
+				char bar[21] = {0};
+
+				memset(bar, '#', MIN(profile->avg * 20 / period, 20));
+
+				GUIFontPrintf(guiFont, 0, GUIFontHeight(guiFont) * (10 + pass), GUI_ALIGN_LEFT, 0x7FFFFFFF, "%-8s %5u %5u %5u us %s",
+					GXTraceName(pass),
+					(uint32_t)ticks_to_microsecs(profile->min),
+					(uint32_t)ticks_to_microsecs(profile->avg),
+					(uint32_t)ticks_to_microsecs(profile->max),
+					bar);
+			}
+		}
+
+		if (romLoad.frame)
+			GUIFontPrintf(guiFont, 0, GUIFontHeight(guiFont) * 8, GUI_ALIGN_LEFT, 0x7FFFFFFF, "rom load %u ms, first frame %u ms",
+				(uint32_t)ticks_to_millisecs(romLoad.load),
+				(uint32_t)ticks_to_millisecs(romLoad.frame));
+
+		#ifdef HW_DOL
+		vm_stats vm;
+		VM_GetStats(&vm);
+
+		if (vm.faults)
+			GUIFontPrintf(guiFont, 0, GUIFontHeight(guiFont) * 6, GUI_ALIGN_LEFT, 0x7FFFFFFF, "vm %u faults %u prefetched, %u in %u out %u cleaned %u dropped, %u dirty, %u ms",
+				vm.faults, vm.prefetch_hits, vm.pages_in, vm.pages_out, vm.cleaned, vm.drops, vm.dirty_reclaims, (uint32_t)ticks_to_millisecs(vm.stall_ticks));
+
+		if (vm.store_bytes)
+			GUIFontPrintf(guiFont, 0, GUIFontHeight(guiFont) * 7, GUI_ALIGN_LEFT, 0x7FFFFFFF, "vm store %u pages in %u KiB, %u full %u lost %u bad",
+				vm.store_pages, vm.store_bytes >> 10, vm.store_full, vm.store_lost, vm.store_errors);
+		#endif
+	}
+
 	dispsize[2] = GX_EndDispList();
 
 	GX_BeginDispList(displist[3], GX_FIFO_MINSIZE);
@@ -398,42 +506,25 @@ static void _guiFinish(void)
 	dispsize[3] = GX_EndDispList();
 }
 
-static struct mStereoSample audioBuffer[2][16384] ATTRIBUTE_ALIGN(32);
-static unsigned audioBufferIndex;
-static unsigned audioBufferSize;
 static unsigned audioRate;
 static double fpsRatio;
 
 static void _audioRateChanged(struct mAVStream *stream, unsigned rate)
 {
 	audioRate = rate * fpsRatio;
-	audioBufferSize = (audioRate * 1024 + (48000 - 1)) / 48000;
-	ASND_ChangePitchVoice(0, audioRate);
+	AudioSetRate(audioRate);
 }
 
 static void _postAudioBuffer(struct mAVStream *stream, struct mAudioBuffer *buffer)
 {
-	uint32_t level;
-
-	if (ASND_TestVoiceBufferReady(0) == SND_OK) {
-		size_t available = mAudioBufferAvailable(buffer) / audioBufferSize * audioBufferSize;
-		mAudioBufferRead(buffer, (int16_t *)audioBuffer[audioBufferIndex], available);
+	static struct mStereoSample samples[1024];
+	size_t count;
 
-		_CPU_ISR_Disable(level);
+	if (runAhead.active)
+		return;
 
-		if (ASND_StatusVoice(0) == SND_UNUSED) {
-			if (ASND_SetVoice(0, VOICE_STEREO_16BIT, audioRate, 0, audioBuffer[audioBufferIndex], available * 4, MAX_VOLUME, MAX_VOLUME, NULL) == SND_OK)
-				audioBufferIndex ^= 1;
-		} else {
-			if (ASND_AddVoice(0, audioBuffer[audioBufferIndex], available * 4) == SND_OK)
-				audioBufferIndex ^= 1;
-		}
-
-		_CPU_ISR_Restore(level);
-	} else {
-		if (mAudioBufferAvailable(buffer) == mAudioBufferCapacity(buffer))
-			mAudioBufferClear(buffer);
-	}
+	while ((count = mAudioBufferRead(buffer, (int16_t *)samples, ARRAY_ELEMS(samples))))
+		AudioWrite(samples, count);
 }
 
 static struct mAVStream stream = {
@@ -571,6 +662,124 @@ static void _updateScreenMode(struct GUIParams *params, unsigned mode)
 
 static void *outputBuffer;
 
+static struct {
+	uint16_t *buffer;
+	uint32_t frames;
+	bool valid;
+	bool faded;
+	int filter;
+	rect_t rect;
+} previousFrame;
+
+static struct {
+	void (*drawScanline)(struct GBAVideoRenderer *renderer, int y);
+	unsigned width, height;
+	unsigned rows;
+} scanlineStream;
+
+// without a filter the planar split needs no GPU pass, the converter
+// writes the CI8 planes that the prescale pass reads directly
+static bool _planarFused(void)
+{
+	return state.filter == FILTER_NONE && state.scale == 1 && !state.verify;
+}
+
+static void _convertRows(unsigned width, unsigned first, unsigned last)
+{
+	if (_planarFused())
+		GBAVideoConvertBGR5PlanarRows(planar_surface.buf, outputBuffer, width, first, last);
+	else GBAVideoConvertBGR5Rows(*convert_surface.buf, outputBuffer, width, first, last);
+}
+
+static void _drawScanline(struct GBAVideoRenderer *renderer, int y)
+{
+	scanlineStream.drawScanline(renderer, y);
+
+	if (++y > scanlineStream.height)
+		return;
+	if (y % state.stream && y != scanlineStream.height)
+		return;
+
+	unsigned first = scanlineStream.rows < y ? scanlineStream.rows : 0;
+
+	if (first == 0)
+		GX_DrawDone();
+
+	_convertRows(scanlineStream.width, first, y);
+	scanlineStream.rows = y;
+
+	if (y == scanlineStream.height)
+		latency.frame = gettime();
+}
+
+static void _runAheadBegin(struct mCore *core)
+{
+	struct mAudioBuffer *audio = core->getAudioBuffer(core);
+	uint64_t start = gettime();
+
+	core->saveState(core, runAhead.state);
+	runAhead.save = diff_ticks(start, gettime());
+	runAhead.samples = mAudioBufferRead(audio, (int16_t *)runAhead.audio, mAudioBufferAvailable(audio));
+
+	runAhead.active = true;
+
+	for (int i = 0; i < state.run_ahead; i++)
+		core->runFrame(core);
+
+	runAhead.active = false;
+}
+
+static void _runAheadEnd(struct mCore *core)
+{
+	struct mAudioBuffer *audio = core->getAudioBuffer(core);
+	uint64_t start = gettime();
+
+	core->loadState(core, runAhead.state);
+	runAhead.load = diff_ticks(start, gettime());
+
+	mAudioBufferClear(audio);
+	mAudioBufferWrite(audio, (int16_t *)runAhead.audio, runAhead.samples);
+}
+
+static bool _diffFrame(unsigned width, unsigned height, unsigned *first, unsigned *last)
+{
+	uint16_t *src = outputBuffer;
+	uint16_t *dst = previousFrame.buffer;
+	size_t size = width * 4 * sizeof(uint16_t);
+
+	*first = height;
+	*last = 0;
+
+	for (unsigned y = 0; y < height; y += 4) {
+		if (memcmp(&dst[y * width], &src[y * width], size)) {
+			memcpy(&dst[y * width], &src[y * width], size);
+			if (*first > y) *first = y;
+			*last = y + 4;
+		}
+	}
+
+	return *first < *last;
+}
+
+#ifdef HW_DOL
+static unsigned vmProfile;
+#endif
+
+static bool (*loadROM)(struct mCore *core, struct VFile *vf);
+
+static bool _loadROM(struct mCore *core, struct VFile *vf)
+{
+	romLoad.start = gettime();
+	romLoad.frame = 0;
+
+	GBAROMBufferLoadBegin(vf);
+	bool loaded = loadROM(core, vf);
+	GBAROMBufferLoadEnd(vf, loaded);
+
+	romLoad.load = diff_ticks(romLoad.start, gettime());
+	return loaded;
+}
+
 static void _setup(struct mGUIRunner *runner)
 {
 	unsigned mode;
@@ -703,23 +912,20 @@ static void _setup(struct mGUIRunner *runner)
 	mInputBindAxis(&runner->params.keyMap, '3ds\0', 1, &(struct mInputAxis){GUI_INPUT_UP, GUI_INPUT_DOWN, +40, -40});
 	mInputBindAxis(&runner->params.keyMap, '3ds\0', 3, &(struct mInputAxis){mGUI_INPUT_INCREASE_BRIGHTNESS, mGUI_INPUT_DECREASE_BRIGHTNESS, +40, -40});
 
-	LWP_SemInit(&semaphore[0], 1, 1);
-	LWP_SemInit(&semaphore[1], 1, 1);
-	SYS_CreateAlarm(&watchdog);
-	VIDEO_SetPostRetraceCallback(vsync_cb);
+	if (runner->core->loadROM != _loadROM) {
+		loadROM = runner->core->loadROM;
+		runner->core->loadROM = _loadROM;
+	}
+
+	PacingSetup();
 }
 
 static void _teardown(struct mGUIRunner *runner)
 {
 	state.quit |= KEY_QUIT;
 
-	VIDEO_SetPostRetraceCallback(NULL);
-	SYS_RemoveAlarm(watchdog);
-	LWP_SemDestroy(semaphore[0]);
-	LWP_SemDestroy(semaphore[1]);
-	watchdog = SYS_WD_NULL;
-	semaphore[0] = LWP_SEM_NULL;
-	semaphore[1] = LWP_SEM_NULL;
+	GXFreeArena(&surface_arena);
+	PacingTeardown();
 }
 
 static void _gameLoaded(struct mGUIRunner *runner)
@@ -739,6 +945,46 @@ static void _gameLoaded(struct mGUIRunner *runner)
 	outputBuffer = GXAllocBuffer(width * height * BYTES_PER_PIXEL);
 	runner->core->setVideoBuffer(runner->core, outputBuffer, width);
 
+	previousFrame.buffer = malloc(width * height * BYTES_PER_PIXEL);
+	previousFrame.valid = false;
+
+	guiFont = runner->params.font;
+
+	if (state.stream) {
+		struct GBA *gba = runner->core->board;
+
+		scanlineStream.width  = width;
+		scanlineStream.height = height;
+		scanlineStream.rows   = 0;
+
+		scanlineStream.drawScanline = gba->video.renderer->drawScanline;
+		gba->video.renderer->drawScanline = _drawScanline;
+	}
+
+	unsigned scaled_width = width * state.scale, scaled_height = height * state.scale;
+	unsigned prescale_width = scaled_width, prescale_height = scaled_height;
+
+	if (state.filter_prescale) {
+		prescale_width  = width * 4;
+		prescale_height = height * MIN(rmode.xfbHeight * 4 / rmode.viHeight, 4);
+	}
+
+	// one term per surface below, the arena is only reallocated when a game needs more
+	uint32_t arena_size =
+		GXGetArenaSurfaceSize(width, height, GX_TF_RGB5A3, 1) +
+		GXGetArenaSurfaceSize(scaled_width, scaled_height, GX_TF_CI8, 3) +
+		GXGetArenaSurfaceSize(prescale_width, prescale_height, GX_TF_I8, 3);
+
+	if (state.filter == FILTER_ACCUMULATE ||
+		state.filter == FILTER_SCALE2XEX)
+		arena_size += GXGetArenaSurfaceSize(width, height, GX_TF_RGBA8, 1);
+
+	if (state.verify)
+		arena_size += GXGetArenaSurfaceSize(scaled_width, scaled_height, GX_TF_I8, 3);
+
+	GXAllocArena(&surface_arena, arena_size);
+	GXSetArena(&surface_arena);
+
 	GXAllocSurface(&convert_surface, width, height, GX_TF_RGB5A3, 1);
 	GXPreloadSurfacev(&convert_surface, (uint32_t[]){0x40000, 0x60000, 0xE0000}, NULL, 3);
 	GXSetSurfaceFilt(&convert_surface, GX_NEAR);
@@ -750,18 +996,41 @@ static void _gameLoaded(struct mGUIRunner *runner)
 		GXSetSurfaceFilt(&packed_surface, GX_NEAR);
 	}
 
-	GXAllocSurface(&planar_surface, width * state.scale, height * state.scale, GX_TF_CI8, 3);
+	GXAllocSurface(&planar_surface, scaled_width, scaled_height, GX_TF_CI8, 3);
 	if (planar_surface.size * 3 > 0x40000)
 		GXPreloadSurfacev(&planar_surface, (uint32_t[]){0x00000, 0x00000, 0x00000}, NULL, 3);
 	else GXPreloadSurface(&planar_surface, 0x00000, 0x00000, 3);
 	GXSetSurfaceFilt(&planar_surface, GX_NEAR);
 
-	if (state.filter_prescale)
-		GXAllocSurface(&prescale_surface, width * 4, height * MIN(rmode.xfbHeight * 4 / rmode.viHeight, 4), GX_TF_I8, 3);
-	else GXAllocSurface(&prescale_surface, width * state.scale, height * state.scale, GX_TF_I8, 3);
+	if (state.verify) {
+		GXAllocSurface(&reference_surface, scaled_width, scaled_height, GX_TF_I8, 3);
+		GXReferenceAlloc(width, height);
+	}
+
+	GXAllocSurface(&prescale_surface, prescale_width, prescale_height, GX_TF_I8, 3);
 	GXSetSurfaceFilt(&prescale_surface, state.scaler == SCALER_NEAREST ? GX_NEAR : GX_LINEAR);
 
+	GXSetArena(NULL);
+
+	GXPlanarAllocState();
+	GXPrescaleAllocState();
+
 	runner->core->setAudioBufferSize(runner->core, 1024 * 3);
+	AudioReset();
+
+	if (state.run_ahead) {
+		struct mAudioBuffer *audio = runner->core->getAudioBuffer(runner->core);
+
+		runAhead.state = memalign(32, runner->core->stateSize(runner->core));
+		runAhead.audio = malloc(mAudioBufferCapacity(audio) * sizeof(struct mStereoSample));
+	}
+
+	#ifdef HW_DOL
+	if (state.vm_pin || state.vm_heat) {
+		VM_ProfileStart();
+		vmProfile = 600;
+	}
+	#endif
 
 	runner->core->setAVStream(runner->core, &stream);
 
@@ -931,16 +1200,54 @@ static void _gameUnloaded(struct mGUIRunner *runner)
 	free(outputBuffer);
 	outputBuffer = NULL;
 
+	free(previousFrame.buffer);
+	previousFrame.buffer = NULL;
+
+	free(runAhead.state);
+	free(runAhead.audio);
+	runAhead.state = NULL;
+	runAhead.audio = NULL;
+
+	#ifdef HW_DOL
+	VM_ProfileStop();
+	vmProfile = 0;
+	#endif
+
+	if (scanlineStream.drawScanline) {
+		struct GBA *gba = runner->core->board;
+
+		gba->video.renderer->drawScanline = scanlineStream.drawScanline;
+		scanlineStream.drawScanline = NULL;
+	}
+
 	GX_DrawDone();
 
 	GXFreeSurface(&convert_surface);
 	GXFreeSurface(&packed_surface);
 	GXFreeSurface(&planar_surface);
 	GXFreeSurface(&prescale_surface);
+	GXFreeSurface(&reference_surface);
+	GXReferenceFree();
+	GXPlanarFreeState();
+	GXPrescaleFreeState();
 }
 
 static void _prepareForFrame(struct mGUIRunner *runner)
 {
+	PacingPrepare();
+
+	#ifdef HW_DOL
+	if (vmProfile) {
+		VM_Sample();
+
+		if (!--vmProfile) {
+			VM_PinHottest(state.vm_pin);
+			VM_DumpHeat(state.vm_heat);
+			VM_ProfileStop();
+		}
+	}
+	#endif
+
 	state.rotation = default_state.rotation;
 
 	if (state.reset) {
@@ -959,6 +1266,19 @@ static void _drawFrame(struct mGUIRunner *runner, bool faded)
 	unsigned width, height;
 	runner->core->currentVideoSize(runner->core, &width, &height);
 
+	bool speculate = runAhead.state && !faded;
+
+	if (!romLoad.frame)
+		romLoad.frame = diff_ticks(romLoad.start, gettime());
+
+	if (speculate)
+		_runAheadBegin(runner->core);
+
+	uint64_t start = gettime();
+
+	if (state.filter_prescale && state.prescale_budget)
+		GXPrescaleAdapt(pacing_stats.average.draw, secs_to_ticks(1) / viclock.hz);
+
 	rect_t planar_src   = {0, 0, width, height};
 	rect_t prescale_src = {0, 0, planar_src.w * state.scale, planar_src.h * state.scale};
 	rect_t prescale_dst = GXPrescaleGetRect(prescale_src.w, prescale_src.h);
@@ -967,70 +1287,140 @@ static void _drawFrame(struct mGUIRunner *runner, bool faded)
 	packed_surface.rect = planar_surface.rect = prescale_src;
 	convert_surface.rect = planar_src;
 
-	GBAVideoConvertBGR5(*convert_surface.buf, outputBuffer, width, height);
-	convert_surface.dirty = true;
+	unsigned first = 0, last = height;
+	bool skip_planar = false, skip_prescale = false;
 
-	switch (state.filter) {
-		case FILTER_BLEND:
-			GXPlanarApplyBlend(&planar_surface, &convert_surface);
-			break;
-		case FILTER_DEFLICKER:
-			GXPlanarApplyDeflicker(&planar_surface, &convert_surface);
-			break;
-		case FILTER_ACCUMULATE:
-			GXPackedApplyMix(&packed_surface, &convert_surface);
-			GXPlanarApply(&planar_surface, &packed_surface);
-			break;
-		case FILTER_SCALE2XEX:
-			GXPackedApplyYUV(&packed_surface, &convert_surface);
-			GXPlanarApplyScale2xEx(&planar_surface, &convert_surface, &packed_surface);
-			break;
-		case FILTER_SCALE2XPLUS:
-			GXPlanarApplyScale2x(&planar_surface, &convert_surface, true);
-			break;
-		case FILTER_SCALE2X:
-			GXPlanarApplyScale2x(&planar_surface, &convert_surface, false);
-			break;
-		case FILTER_EAGLE2X:
-			GXPlanarApplyEagle2x(&planar_surface, &convert_surface);
-			break;
-		case FILTER_SCAN2X:
-			GXPlanarApplyScan2x(&planar_surface, &convert_surface, false);
-			break;
-		default:
-			GXPlanarApply(&planar_surface, &convert_surface);
-	}
+	if (previousFrame.valid && previousFrame.filter == state.filter) {
+		if (_diffFrame(width, height, &first, &last))
+			previousFrame.frames = 0;
+		else previousFrame.frames++;
 
-	if (faded) {
-		gx_surface_t *planar_surfaces[GX_MAX_TEXMAP] = {&planar_surface};
-		uint8_t planar_alpha[GX_MAX_TEXMAP] = {0xC0};
-		uint32_t planar_count = 1;
+		switch (state.filter) {
+			case FILTER_BLEND:
+			case FILTER_DEFLICKER:
+				skip_planar = previousFrame.frames >= convert_surface.shadows;
+				break;
+			case FILTER_ACCUMULATE:
+				break;
+			default:
+				skip_planar = previousFrame.frames > 0;
+		}
 
 		switch (state.dither) {
-			case DITHER_NONE:
-				GXPrescaleApplyBlend(&prescale_surface, planar_surfaces, planar_alpha, planar_count);
-				break;
 			case DITHER_THRESHOLD:
 			case DITHER_BAYER2x2:
-				GXPrescaleApplyBlendDitherFast(&prescale_surface, planar_surfaces, planar_alpha, planar_count);
 				break;
 			default:
-				GXPrescaleApplyBlendDither(&prescale_surface, planar_surfaces, planar_alpha, planar_count);
+				skip_prescale = skip_planar &&
+					previousFrame.faded == faded &&
+					!memcmp(&previousFrame.rect, &prescale_surface.rect, sizeof(rect_t));
 		}
 	} else {
-		switch (state.dither) {
-			case DITHER_NONE:
-				GXPrescaleApply(&prescale_surface, &planar_surface);
+		memcpy(previousFrame.buffer, outputBuffer, width * height * BYTES_PER_PIXEL);
+		previousFrame.frames = 0;
+		previousFrame.valid = true;
+		previousFrame.filter = state.filter;
+	}
+
+	previousFrame.faded = faded;
+	previousFrame.rect = prescale_surface.rect;
+
+	if (scanlineStream.drawScanline) {
+		first = scanlineStream.rows < height ? scanlineStream.rows : height;
+		last = height;
+		scanlineStream.rows = 0;
+	} else latency.frame = gettime();
+
+	if (first < last) {
+		GXTraceBegin(GX_PASS_CONVERT);
+		_convertRows(width, first, last);
+		GXTraceEnd(GX_PASS_CONVERT);
+	}
+
+	PacingDrawStart();
+
+	if (!skip_planar && !_planarFused()) {
+		convert_surface.dirty = true;
+
+		GXTraceBegin(GX_PASS_PLANAR);
+
+		switch (state.filter) {
+			case FILTER_BLEND:
+				GXPlanarApplyBlend(&planar_surface, &convert_surface);
 				break;
-			case DITHER_THRESHOLD:
-			case DITHER_BAYER2x2:
-				GXPrescaleApplyDitherFast(&prescale_surface, &planar_surface);
+			case FILTER_DEFLICKER:
+				GXPlanarApplyDeflicker(&planar_surface, &convert_surface);
+				break;
+			case FILTER_ACCUMULATE:
+				GXPackedApplyMix(&packed_surface, &convert_surface);
+				GXPlanarApply(&planar_surface, &packed_surface);
+				break;
+			case FILTER_SCALE2XEX:
+				GXPackedApplyYUV(&packed_surface, &convert_surface);
+				GXPlanarApplyScale2xEx(&planar_surface, &convert_surface, &packed_surface);
+				break;
+			case FILTER_SCALE2XPLUS:
+				GXPlanarApplyScale2x(&planar_surface, &convert_surface, true);
+				break;
+			case FILTER_SCALE2X:
+				GXPlanarApplyScale2x(&planar_surface, &convert_surface, false);
+				break;
+			case FILTER_EAGLE2X:
+				GXPlanarApplyEagle2x(&planar_surface, &convert_surface);
+				break;
+			case FILTER_SCAN2X:
+				GXPlanarApplyScan2x(&planar_surface, &convert_surface, false);
 				break;
 			default:
-				GXPrescaleApplyDither(&prescale_surface, &planar_surface);
+				GXPlanarApply(&planar_surface, &convert_surface);
 		}
+
+		GXTraceEnd(GX_PASS_PLANAR);
+
+		if (state.verify)
+			GXReferenceVerify(&reference_surface, &planar_surface, &convert_surface, outputBuffer);
 	}
 
+	if (!skip_prescale) {
+		planar_surface.dirty = true;
+
+		GXTraceBegin(GX_PASS_PRESCALE);
+
+		if (faded) {
+			gx_surface_t *planar_surfaces[GX_MAX_TEXMAP] = {&planar_surface};
+			uint8_t planar_alpha[GX_MAX_TEXMAP] = {0xC0};
+			uint32_t planar_count = 1;
+
+			switch (state.dither) {
+				case DITHER_NONE:
+					GXPrescaleApplyBlend(&prescale_surface, planar_surfaces, planar_alpha, planar_count);
+					break;
+				case DITHER_THRESHOLD:
+				case DITHER_BAYER2x2:
+					GXPrescaleApplyBlendDitherFast(&prescale_surface, planar_surfaces, planar_alpha, planar_count);
+					break;
+				default:
+					GXPrescaleApplyBlendDither(&prescale_surface, planar_surfaces, planar_alpha, planar_count);
+			}
+		} else {
+			switch (state.dither) {
+				case DITHER_NONE:
+					GXPrescaleApply(&prescale_surface, &planar_surface);
+					break;
+				case DITHER_THRESHOLD:
+				case DITHER_BAYER2x2:
+					GXPrescaleApplyDitherFast(&prescale_surface, &planar_surface);
+					break;
+				default:
+					GXPrescaleApplyDither(&prescale_surface, &planar_surface);
+			}
+		}
+
+		GXTraceEnd(GX_PASS_PRESCALE);
+	}
+
+	PacingDrawEnd();
+
 	GX_BeginDispList(displist[0], GX_FIFO_MINSIZE);
 
 	GX_SetViewportJitter(viewport.x + state.offset.x, viewport.y + state.offset.y + (viewport.h % 2) / 2., viewport.w, viewport.h, 0., 1., state.field);
@@ -1044,6 +1434,11 @@ static void _drawFrame(struct mGUIRunner *runner, bool faded)
 	GXOverlayDrawRect((rect_t){0, 0, GBA_VIDEO_HORIZONTAL_PIXELS, GBA_VIDEO_VERTICAL_PIXELS});
 
 	dispsize[1] = GX_EndDispList();
+
+	latency.draw = diff_ticks(start, gettime());
+
+	if (speculate)
+		_runAheadEnd(runner->core);
 }
 
 static void _drawScreenshot(struct mGUIRunner *runner, const mColor *pixels, unsigned width, unsigned height, bool faded)
@@ -1058,6 +1453,7 @@ static void _drawScreenshot(struct mGUIRunner *runner, const mColor *pixels, uns
 
 	GBAVideoConvertBGR5(*convert_surface.buf, (void *)pixels, width, height);
 	convert_surface.dirty = true;
+	previousFrame.valid = false;
 
 	switch (state.filter) {
 		case FILTER_BLEND:
@@ -1139,8 +1535,7 @@ static void _paused(struct mGUIRunner *runner)
 {
 	state.draw_osd = true;
 
-	SYS_CancelAlarm(watchdog);
-	VIDEO_SetPostRetraceCallback(vsync_cb);
+	PacingSetVsync();
 
 	gxclock.reset = true;
 	gxclock.hz = viclock.hz;
@@ -1161,22 +1556,22 @@ static void _unpaused(struct mGUIRunner *runner)
 		if (state.filter < FILTER_DEFLICKER)
 			state.filter = interframeBlending;
 
-	if (mCoreConfigGetBoolValue(&runner->config, "videoSync", &sync) && !sync) {
-		if (mCoreConfigGetFloatValue(&runner->config, "fpsTarget", &fps)) {
-			struct timespec tv;
+	if (!mCoreConfigGetBoolValue(&runner->config, "videoSync", &sync))
+		sync = true;
 
-			tv.tv_sec  = 0;
-			tv.tv_nsec = TB_NSPERSEC / fps;
+	if (!sync || state.pacing == PACING_MAILBOX) {
+		if (!mCoreConfigGetFloatValue(&runner->config, "fpsTarget", &fps))
+			fps = viclock.hz;
 
-			gxclock.reset = true;
-			gxclock.hz = fps;
+		gxclock.reset = true;
+		gxclock.hz = fps;
 
-			VIDEO_SetPostRetraceCallback(NULL);
-			SYS_SetPeriodicAlarm(watchdog, &tv, &tv, alarm_cb, NULL);
-		}
+		PacingSetRate(fps);
 	} else {
 		gxclock.reset = true;
 		gxclock.hz = viclock.hz;
+
+		PacingSetVsync();
 	}
 
 	fpsRatio = ASND_GetAudioRate() / (mCoreCalculateFramerateRatio(runner->core, gxclock.hz) * aiclock.hz);
@@ -1416,6 +1811,16 @@ static void preinit(int argc, char **argv)
 		OPT_IPV4_NETMASK,
 		OPT_NETWORK,
 		OPT_NO_NETWORK,
+		OPT_TRACE,
+		OPT_VERIFY,
+		OPT_STREAM,
+		OPT_LATENCY,
+		OPT_PACING,
+		OPT_RUN_AHEAD,
+		OPT_VM_PIN,
+		OPT_VM_HEAT,
+		OPT_PRESCALE_BUDGET,
+		OPT_PROFILE_GX,
 	};
 	int optc, longind;
 	static struct option longopts[] = {
@@ -1449,6 +1854,16 @@ static void preinit(int argc, char **argv)
 		{ "ipv4-netmask",    required_argument, NULL, OPT_IPV4_NETMASK  },
 		{ "network",         no_argument,       NULL, OPT_NETWORK       },
 		{ "no-network",      no_argument,       NULL, OPT_NO_NETWORK    },
+		{ "trace",           optional_argument, NULL, OPT_TRACE         },
+		{ "verify",          no_argument,       NULL, OPT_VERIFY        },
+		{ "stream",          optional_argument, NULL, OPT_STREAM        },
+		{ "latency",         no_argument,       NULL, OPT_LATENCY       },
+		{ "pacing",          required_argument, NULL, OPT_PACING        },
+		{ "run-ahead",       optional_argument, NULL, OPT_RUN_AHEAD     },
+		{ "vm-pin",          required_argument, NULL, OPT_VM_PIN        },
+		{ "vm-heat",         optional_argument, NULL, OPT_VM_HEAT       },
+		{ "prescale-budget", optional_argument, NULL, OPT_PRESCALE_BUDGET },
+		{ "profile-gx",      optional_argument, NULL, OPT_PROFILE_GX    },
 		{ NULL }
 	};
 	while ((optc = getopt_long(argc, argv, "-", longopts, &longind)) != EOF) {
@@ -2121,6 +2536,57 @@ static void preinit(int argc, char **argv)
 			case OPT_NO_NETWORK:
 				network.disabled = true;
 				break;
+			case OPT_TRACE:
+				state.trace = optarg ? optarg : "trace.csv";
+				break;
+			case OPT_VERIFY:
+				state.verify = true;
+				break;
+			case OPT_STREAM:
+				state.stream = optarg ? MAX((strtoul(optarg, NULL, 10) + 3) & ~3, 4) : 16;
+				break;
+			case OPT_LATENCY:
+				state.draw_latency = true;
+				break;
+			case OPT_PACING:
+			{
+				char *options = optarg, *value;
+				static char *tokens[] = {
+					[PACING_VSYNC]   = "vsync",
+					[PACING_JIT]     = "jit",
+					[PACING_MAILBOX] = "mailbox",
+					NULL
+				};
+				while (*options) {
+					switch (getsubopt(&options, tokens, &value)) {
+						case PACING_VSYNC:
+							state.pacing = PACING_VSYNC;
+							break;
+						case PACING_JIT:
+							state.pacing = PACING_JIT;
+							break;
+						case PACING_MAILBOX:
+							state.pacing = PACING_MAILBOX;
+							break;
+					}
+				}
+				break;
+			}
+			case OPT_RUN_AHEAD:
+				state.run_ahead = optarg ? MIN(strtoul(optarg, NULL, 10), 4) : 1;
+				break;
+			case OPT_VM_PIN:
+				state.vm_pin = strtoul(optarg, NULL, 10);
+				break;
+			case OPT_VM_HEAT:
+				state.vm_heat = optarg ? optarg : "vmheat.csv";
+				break;
+			case OPT_PRESCALE_BUDGET:
+				state.prescale_budget = optarg ? MIN(MAX(strtoul(optarg, NULL, 10), 10), 100) : 70;
+				break;
+			case OPT_PROFILE_GX:
+				state.gx_profile = optarg ? optarg : "profile.csv";
+				break;
 		}
 	}
 
@@ -2134,8 +2600,6 @@ int main(int argc, char **argv)
 	preinit(argc, argv);
 
 	GXInit();
-	GXPlanarAllocState();
-	GXPrescaleAllocState();
 	GXPreviewAllocState();
 	GXOverlayAllocState();
 	GXFontAllocState();
@@ -2147,6 +2611,8 @@ int main(int argc, char **argv)
 	displist[3] = GXAllocBuffer(GX_FIFO_MINSIZE);
 
 	GXOverlayReadFile(state.overlay, state.overlay_id);
+	GXTraceOpen(state.trace);
+	if (state.gx_profile) GXProfileStart();
 
 	InputInit();
 	GBAInit();
@@ -2494,6 +2960,8 @@ int main(int argc, char **argv)
 	else mGUIRun(&runner, state.path);
 	mGUIDeinit(&runner);
 
+	GXTraceClose();
+	GXProfileStop(state.gx_profile);
 	VideoBlackOut();
 
 	#ifdef HW_RVL
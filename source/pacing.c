@@ -0,0 +1,208 @@
+/* 
+ * Copyright (c) 2015-2025, Extrems' Corner.org
+ * 
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include <math.h>
+#include <unistd.h>
+#include <gccore.h>
+#include <ogc/lwp_watchdog.h>
+#include "pacing.h"
+#include "state.h"
+#include "video.h"
+
+#define PACING_MARGIN microsecs_to_ticks(1000)
+
+static sem_t semaphore[2] = { LWP_SEM_NULL, LWP_SEM_NULL };
+static syswd_t watchdog = SYS_WD_NULL;
+
+static bool vsync;
+static uint64_t period;
+static uint64_t tick_time;
+static uint64_t emulate_time;
+static uint64_t gx_time;
+static uint64_t draw_time;
+
+static pacing_frame_t frame;
+
+pacing_stats_t pacing_stats;
+
+static void tick_cb(void)
+{
+	tick_time = gettime();
+	LWP_SemPost(semaphore[0]);
+}
+
+static void alarm_cb(syswd_t alarm, void *arg)
+{
+	tick_cb();
+}
+
+static void vsync_cb(uint32_t retrace)
+{
+	tick_cb();
+}
+
+static void wait_tick(void)
+{
+	uint64_t start = gettime();
+	LWP_SemWait(semaphore[0]);
+	frame.wait += diff_ticks(start, gettime());
+}
+
+static void average(uint64_t *avg, uint64_t value)
+{
+	*avg = *avg ? *avg + ((int64_t)(value - *avg) >> 4) : value;
+}
+
+static uint64_t tick_period(void)
+{
+	if (vsync)
+		return isnormal(viclock.hz) ? secs_to_ticks(1) / viclock.hz : 0;
+	return period;
+}
+
+void PacingSetup(void)
+{
+	LWP_SemInit(&semaphore[0], 1, 1);
+	LWP_SemInit(&semaphore[1], 1, 1);
+	SYS_CreateAlarm(&watchdog);
+	PacingSetVsync();
+}
+
+void PacingTeardown(void)
+{
+	VIDEO_SetPostRetraceCallback(NULL);
+	SYS_RemoveAlarm(watchdog);
+	LWP_SemDestroy(semaphore[0]);
+	LWP_SemDestroy(semaphore[1]);
+	watchdog = SYS_WD_NULL;
+	semaphore[0] = LWP_SEM_NULL;
+	semaphore[1] = LWP_SEM_NULL;
+}
+
+void PacingSetVsync(void)
+{
+	SYS_CancelAlarm(watchdog);
+	VIDEO_SetPostRetraceCallback(vsync_cb);
+
+	vsync = true;
+}
+
+void PacingSetRate(double hz)
+{
+	struct timespec tv;
+
+	tv.tv_sec  = 0;
+	tv.tv_nsec = TB_NSPERSEC / hz;
+
+	VIDEO_SetPostRetraceCallback(NULL);
+	SYS_SetPeriodicAlarm(watchdog, &tv, &tv, alarm_cb, NULL);
+
+	vsync = false;
+	period = secs_to_ticks(1) / hz;
+}
+
+void PacingPrepare(void)
+{
+	if (emulate_time) {
+		pacing_stats.last = frame;
+		pacing_stats.frames++;
+
+		average(&pacing_stats.average.emulate, frame.emulate);
+		average(&pacing_stats.average.wait,    frame.wait);
+		average(&pacing_stats.average.gx,      frame.gx);
+		average(&pacing_stats.average.draw,    frame.draw);
+	}
+
+	frame.emulate = 0;
+	frame.wait = 0;
+
+	if (state.pacing == PACING_JIT && state.draw_wait) {
+		wait_tick();
+
+		uint64_t period = tick_period();
+		uint64_t budget = pacing_stats.average.emulate + pacing_stats.average.gx + PACING_MARGIN;
+
+		if (period > budget) {
+			uint64_t start = gettime();
+			uint64_t elapsed = diff_ticks(tick_time, start);
+			uint64_t deadline = period - budget;
+
+			if (elapsed < deadline) {
+				usleep(ticks_to_microsecs(deadline - elapsed));
+				frame.wait += diff_ticks(start, gettime());
+			} else pacing_stats.missed++;
+		} else pacing_stats.missed++;
+	}
+
+	emulate_time = gettime();
+}
+
+void PacingWait(void)
+{
+	uint64_t start = gettime();
+
+	if (emulate_time)
+		frame.emulate = diff_ticks(emulate_time, start);
+
+	if (state.pacing != PACING_JIT && state.draw_wait)
+		wait_tick();
+
+	start = gettime();
+
+	// mailbox keeps drawing while a framebuffer is free, so up to two
+	// frames can be in flight and the newest finished one is shown
+	if (state.pacing == PACING_MAILBOX) {
+		while (!VideoFramebufferAvailable())
+			LWP_SemWait(semaphore[1]);
+	} else LWP_SemWait(semaphore[1]);
+
+	frame.wait += diff_ticks(start, gettime());
+}
+
+// mark where the GPU starts on the frame's own passes
+void PacingDrawStart(void)
+{
+	GX_SetDrawSync(PACING_TOKEN);
+}
+
+// and where they end, before the CPU-bound tail of the frame
+void PacingDrawEnd(void)
+{
+	GX_SetDrawSync(PACING_TOKEN_END);
+}
+
+bool PacingToken(uint16_t token)
+{
+	switch (token) {
+		case PACING_TOKEN:
+			draw_time = gettime();
+			return true;
+		case PACING_TOKEN_END:
+			if (draw_time) {
+				frame.draw = diff_ticks(draw_time, gettime());
+				draw_time = 0;
+			}
+			return true;
+		default:
+			return false;
+	}
+}
+
+void PacingSubmit(void)
+{
+	gx_time = gettime();
+}
+
+void PacingDrawDone(void)
+{
+	uint64_t now = gettime();
+
+	frame.gx = diff_ticks(gx_time, now);
+
+	LWP_SemPost(semaphore[1]);
+}
@@ -0,0 +1,46 @@
+/* 
+ * Copyright (c) 2015-2025, Extrems' Corner.org
+ * 
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef GBI_PACING_H
+#define GBI_PACING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PACING_TOKEN     0x4000
+#define PACING_TOKEN_END 0x4001
+
+typedef struct {
+	uint64_t emulate;
+	uint64_t wait;
+	uint64_t gx;
+	uint64_t draw;
+} pacing_frame_t;
+
+typedef struct {
+	pacing_frame_t last;
+	pacing_frame_t average;
+	uint32_t frames;
+	uint32_t missed;
+} pacing_stats_t;
+
+extern pacing_stats_t pacing_stats;
+
+void PacingSetup(void);
+void PacingTeardown(void);
+void PacingSetVsync(void);
+void PacingSetRate(double hz);
+void PacingPrepare(void);
+void PacingWait(void);
+void PacingDrawStart(void);
+void PacingDrawEnd(void);
+bool PacingToken(uint16_t token);
+void PacingSubmit(void);
+void PacingDrawDone(void);
+
+#endif /* GBI_PACING_H */
@@ -36,6 +36,22 @@ typedef struct {
 	unsigned overlay_id;
 	struct { float x, y; } overlay_scale;
 
+	const char *trace;
+	const char *gx_profile;
+	bool verify;
+	unsigned stream;
+	bool draw_latency;
+	unsigned run_ahead;
+	unsigned vm_pin;
+	const char *vm_heat;
+
+	enum {
+		PACING_VSYNC = 0,
+		PACING_JIT,
+		PACING_MAILBOX,
+		PACING_MAX
+	} pacing;
+
 	enum {
 		FILTER_NONE = 0,
 		FILTER_BLEND,
@@ -52,6 +68,7 @@ typedef struct {
 
 	float filter_weight[3];
 	bool filter_prescale;
+	unsigned prescale_budget;
 
 	enum {
 		DITHER_NONE = 0,
@@ -13,7 +13,8 @@
 #include "video.h"
 
 static void *xfb[3];
-static uint32_t xfb_index;
+static uint32_t xfb_index, xfb_next;
+static vu32 xfb_busy;
 
 GXRModeObj rmode;
 rect_t viewport, screen;
@@ -177,19 +178,43 @@ void VideoBlackOut(void)
 	VIDEO_WaitForFlush();
 }
 
+// neither on screen, queued for the next retrace, nor still being drawn
+static bool VideoFramebufferFree(uint32_t index)
+{
+	return xfb[index] != VIDEO_GetCurrentFramebuffer() && index != xfb_next && !(xfb_busy & (1 << index));
+}
+
+bool VideoFramebufferAvailable(void)
+{
+	for (uint32_t i = 0; i < ARRAY_ELEMS(xfb); i++)
+		if (VideoFramebufferFree(i))
+			return true;
+
+	return false;
+}
+
 void *VideoGetFramebuffer(uint32_t *index)
 {
+	uint32_t level;
+
 	do {
 		xfb_index = (xfb_index + 1) % ARRAY_ELEMS(xfb);
-	} while (xfb[xfb_index] == VIDEO_GetCurrentFramebuffer());
+	} while (!VideoFramebufferFree(xfb_index));
+
+	_CPU_ISR_Disable(level);
+	xfb_busy |= 1 << xfb_index;
+	_CPU_ISR_Restore(level);
 
 	if (index)
 		*index = xfb_index;
 	return xfb[xfb_index];
 }
 
+// a newer frame replaces one still waiting for the retrace
 void VideoSetFramebuffer(uint32_t index)
 {
-	VIDEO_SetNextFramebuffer(xfb[index % ARRAY_ELEMS(xfb)]);
+	xfb_next = index % ARRAY_ELEMS(xfb);
+	xfb_busy &= ~(1 << xfb_next);
+	VIDEO_SetNextFramebuffer(xfb[xfb_next]);
 	VIDEO_Flush();
 }
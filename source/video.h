@@ -9,6 +9,7 @@
 #ifndef GBI_VIDEO_H
 #define GBI_VIDEO_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <ogc/gx_struct.h>
 #include "clock.h"
@@ -24,6 +25,7 @@ extern timing_t viclock;
 
 void VideoSetup(uint32_t tvMode, uint32_t viMode, uint32_t xfbMode);
 void VideoBlackOut(void);
+bool VideoFramebufferAvailable(void);
 void *VideoGetFramebuffer(uint32_t *index);
 void VideoSetFramebuffer(uint32_t index);
 
@@ -0,0 +1,163 @@
+/* 
+ * Copyright (c) 2015-2025, Extrems' Corner.org
+ * 
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include <string.h>
+#include "lz4.h"
+
+#define MIN_MATCH    4
+#define LAST_LITERALS 5
+#define MF_LIMIT     12
+#define HASH_BITS    12
+
+// shared by every call, LZ4Compress isn't reentrant
+static uint16_t table[1 << HASH_BITS];
+
+static inline uint32_t read32(const uint8_t *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline uint32_t hash(uint32_t value)
+{
+	return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static uint8_t *put_length(uint8_t *op, uint8_t *end, int length)
+{
+	for (; length >= 255; length -= 255) {
+		if (op >= end) return NULL;
+		*op++ = 255;
+	}
+
+	if (op >= end) return NULL;
+	*op++ = length;
+	return op;
+}
+
+static uint8_t *put_sequence(uint8_t *op, uint8_t *end, const uint8_t *literals, int count, int offset, int match)
+{
+	uint8_t *token = op++;
+
+	if (op > end) return NULL;
+
+	*token = (count < 15 ? count : 15) << 4;
+	if (count >= 15 && !(op = put_length(op, end, count - 15)))
+		return NULL;
+
+	if (op + count > end) return NULL;
+	memcpy(op, literals, count);
+	op += count;
+
+	if (!offset)
+		return op;
+
+	if (op + 2 > end) return NULL;
+	*op++ = offset;
+	*op++ = offset >> 8;
+
+	match -= MIN_MATCH;
+	*token |= match < 15 ? match : 15;
+	if (match >= 15 && !(op = put_length(op, end, match - 15)))
+		return NULL;
+
+	return op;
+}
+
+int LZ4Compress(uint8_t *dst, int capacity, const uint8_t *src, int size)
+{
+	const uint8_t *ip = src, *anchor = src;
+	const uint8_t *limit = src + size - MF_LIMIT;
+	const uint8_t *match_limit = src + size - LAST_LITERALS;
+	uint8_t *op = dst, *end = dst + capacity;
+
+	memset(table, 0xFF, sizeof(table));
+
+	while (size > MF_LIMIT && ip < limit) {
+		uint32_t h = hash(read32(ip));
+		const uint8_t *ref = src + table[h];
+		int length;
+
+		table[h] = ip - src;
+
+		if (ref >= ip || ip - ref > 0xFFFF || read32(ref) != read32(ip)) {
+			ip++;
+			continue;
+		}
+
+		for (length = MIN_MATCH; ip + length < match_limit && ref[length] == ip[length]; length++);
+
+		if (!(op = put_sequence(op, end, anchor, ip - anchor, ip - ref, length)))
+			return 0;
+
+		ip += length;
+		anchor = ip;
+	}
+
+	if (!(op = put_sequence(op, end, anchor, src + size - anchor, 0, 0)))
+		return 0;
+
+	return op - dst;
+}
+
+int LZ4Decompress(uint8_t *dst, int size, const uint8_t *src, int length)
+{
+	const uint8_t *ip = src, *ip_end = src + length;
+	uint8_t *op = dst, *op_end = dst + size;
+
+	while (ip < ip_end) {
+		uint8_t token = *ip++;
+		int count = token >> 4;
+
+		if (count == 15) {
+			uint8_t byte;
+			do {
+				if (ip >= ip_end) return -1;
+				count += byte = *ip++;
+			} while (byte == 255);
+		}
+
+		if (ip + count > ip_end || op + count > op_end)
+			return -1;
+
+		memcpy(op, ip, count);
+		ip += count;
+		op += count;
+
+		// the last sequence has no match, anything after it is padding
+		if (ip >= ip_end || op == op_end)
+			break;
+
+		if (ip + 2 > ip_end)
+			return -1;
+
+		const uint8_t *ref = op - (ip[0] | ip[1] << 8);
+		ip += 2;
+
+		if (ref < dst || ref == op)
+			return -1;
+
+		count = (token & 15) + MIN_MATCH;
+
+		if ((token & 15) == 15) {
+			uint8_t byte;
+			do {
+				if (ip >= ip_end) return -1;
+				count += byte = *ip++;
+			} while (byte == 255);
+		}
+
+		if (op + count > op_end)
+			return -1;
+
+		// overlapping copies repeat the pattern
+		while (count--)
+			*op++ = *ref++;
+	}
+
+	return op - dst;
+}
@@ -0,0 +1,18 @@
+/* 
+ * Copyright (c) 2015-2025, Extrems' Corner.org
+ * 
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef GBI_VM_LZ4_H
+#define GBI_VM_LZ4_H
+
+#include <stdint.h>
+
+// LZ4 block format, sized for single pages, not reentrant
+int LZ4Compress(uint8_t *dst, int capacity, const uint8_t *src, int size);
+int LZ4Decompress(uint8_t *dst, int size, const uint8_t *src, int length);
+
+#endif /* GBI_VM_LZ4_H */
@@ -7,59 +7,48 @@
 #include <stdlib.h>
 #include <malloc.h>
 #include <errno.h>
+#include <string.h>
 #include <ogc/machine/processor.h>
+#include <ogc/lwp_watchdog.h>
 
 #include "vm.h"
+#include "vm_pager.h"
+#include "vm_slab.h"
+#include "lz4.h"
 
 #include <stdio.h>
 
 // maximum virtual memory size
 #define MAX_VM_SIZE      (256*1024*1024)
 // maximum physical memory size
-#define MAX_MEM_SIZE     (  8*1024*1024)
+#define MAX_MEM_SIZE     ( 16*1024*1024)
 // minimum physical memory size
 #define MIN_MEM_SIZE     (256*1024)
 // page size as defined by hardware
 #define PAGE_SIZE        4096
 #define PAGE_MASK        (~(PAGE_SIZE-1))
+#define MAX_PAGES        (MAX_MEM_SIZE/PAGE_SIZE)
 
 #define VM_VSID          0
 #define VM_SEGMENT       0x70000000
 
-// use 64KB for PTEs
-#define HTABMASK         0
-#define PTE_SIZE         ((HTABMASK+1)*65536)
+// use 64KB for PTEs per 8MB of physical memory
+#define MAX_HTABMASK     ((MAX_PAGES-1)>>11)
+#define PTE_SIZE         ((htabmask+1)*65536)
 #define PTE_COUNT        (PTE_SIZE>>3)
+#define PTEG_COUNT       (PTE_COUNT>>3)
+#define PTE_NONE         0xFFFF
 
-#define VM_FILENAME      "/tmp/pagefile.sys"
+// referenced and changed bits of PTEs pushed out of the table
+#define PTE_R            1
+#define PTE_C            2
 
-// keeps a record of each currently mapped page
-typedef union
-{
-	u32 data;
-	struct
-	{
-		// is this a valid physical page?
-		u32 valid      :  1;
-		// can this page be flushed?
-		u32 locked     :  1;
-		// does this page contain changes?
-		u32 dirty      :  1;
-		// PTE for this physical page
-		u32 pte_index  : 13;
-		// virtual page index for this physical page
-		u32 page_index : 16;
-	};
-} p_map;
+#define VM_FILENAME      "/tmp/pagefile.sys"
 
-// maps VM addresses to mapped pages
-typedef struct
-{
-	// data must be fetched when paging in?
-	u16 committed  :  1;
-	// physical page index for this virtual page
-	u16 p_map_index: 12;
-} vm_map;
+// background page reads in flight
+#define PREFETCH_SLOTS   8
+// slot of a read the waiter gave up on, freed by its callback
+#define PREFETCH_DROPPED 0xFFFE
 
 typedef union
 {
@@ -84,15 +73,40 @@ typedef PTE* PTEG;
 
 typedef u8 vm_page[PAGE_SIZE];
 
-static p_map phys_map[2048];
-static vm_map virt_map[65536];
-static u16 pmap_max, pmap_head;
+// PTE for each physical page
+static u16 pte_map[MAX_PAGES];
+// virtual page each physical page is mapped at
+static u16 pte_page[MAX_PAGES];
+static u8 pte_saved[MAX_PAGES];
+// physical page for each PTE
+static u16 pte_owner[(MAX_HTABMASK+1)*8192];
+// occupied slots and next victim slot for each PTEG
+static u8 pteg_used[(MAX_HTABMASK+1)*1024];
+static u8 pteg_victim[(MAX_HTABMASK+1)*1024];
+static u32 htabmask;
+static u16 pmap_max;
+static u64 stall_ticks;
+// referenced samples per virtual page while profiling
+static u16* heat = NULL;
+static u32 heat_samples;
 
 static PTE* HTABORG;
 static vm_page* VM_Base;
 static vm_page* MEM_Base = NULL;
 
 static ARQRequest vm_request;
+static ARQRequest prefetch_request[PREFETCH_SLOTS];
+// physical page each prefetch slot is reading into
+static vu16 prefetch_page[PREFETCH_SLOTS];
+// reads land here and are copied or unpacked by the waiter
+static u8 prefetch_buf[PREFETCH_SLOTS][PAGE_SIZE] ATTRIBUTE_ALIGN(32);
+static u16 prefetch_length[PREFETCH_SLOTS];
+static vu8 prefetch_done[PREFETCH_SLOTS];
+
+// compressed backing store slot for each virtual page
+static u32* zmap = NULL;
+static u32 zmap_size, zpages, zerrors;
+static u8 zbuf[PAGE_SIZE] ATTRIBUTE_ALIGN(32);
 static mutex_t vm_mutex = LWP_MUTEX_NULL;
 static u32 vm_initialized = 0;
 
@@ -101,123 +115,355 @@ static __inline__ void tlbie(void* p)
 	asm volatile("tlbie %0" :: "r"(p));
 }
 
-static u16 locate_oldest(void)
+static u32 CalcPTEG(u32 virtual, int secondary)
 {
-	u16 head = pmap_head;
+	u32 hash = ((virtual >> 12) & 0xFFFF) ^ VM_VSID;
+
+	if (secondary) hash = ~hash;
 
-	for(;;++head)
+	return hash & ((htabmask << 10) | 0x3FF);
+}
+
+static void remove_pte(u16 index)
+{
+	PTE *p = HTABORG+index;
+	u16 owner = pte_owner[index];
+
+	tlbie(VM_Base+pte_page[owner]);
+	pte_saved[owner] |= (p->R ? PTE_R : 0) | (p->C ? PTE_C : 0);
+	p->data[0] = 0;
+
+	pteg_used[index>>3] &= ~(1 << (index&7));
+	pte_map[owner] = PTE_NONE;
+}
+
+static u16 insert_pte(u16 p_index, u16 v_index, u8 WIMG, u8 PP)
+{
+	u32 virtual = (u32)(VM_Base+v_index);
+	u32 group = 0;
+	u16 index;
+	int secondary;
+	PTE p = {{0}};
+
+	for (secondary=0; secondary < 2; secondary++)
 	{
-		PTE *p;
+		group = CalcPTEG(virtual, secondary);
+		if (pteg_used[group] != 0xFF)
+			break;
+	}
 
-		if (head >= pmap_max)
-			head = 0;
+	// both groups are full, push a PTE out of the primary one
+	if (secondary == 2)
+	{
+		secondary = 0;
+		group = CalcPTEG(virtual, 0);
+		remove_pte(group*8 + (pteg_victim[group]++ & 7));
+	}
 
-		if (!phys_map[head].valid || phys_map[head].locked)
-			continue;
+	index = group*8 + __builtin_ctz(~pteg_used[group]);
+
+	p.valid = 1;
+	p.VSID = VM_VSID;
+	p.hash = secondary;
+	p.API = virtual >> 22;
+	p.RPN = MEM_VIRTUAL_TO_PHYSICAL(MEM_Base+p_index) >> 12;
+	p.WIMG = WIMG;
+	p.PP = PP;
+
+	tlbie((void*)virtual);
+	HTABORG[index].data[1] = p.data[1];
+	HTABORG[index].data[0] = p.data[0];
+
+	pteg_used[group] |= 1 << (index&7);
+	pte_owner[index] = p_index;
+	pte_page[p_index] = v_index;
+
+	return index;
+}
+
+static void tlbia(void)
+{
+	int i;
+	for (i=0; i < 64; i++)
+		asm volatile("tlbie %0" :: "r" (i*PAGE_SIZE));
+}
+
+static int mmu_changed(u16 p_index, u16 v_index)
+{
+	int changed = pte_saved[p_index] & PTE_C;
+
+	pte_saved[p_index] &= ~PTE_C;
+
+	if (pte_map[p_index] != PTE_NONE)
+	{
+		PTE *p = HTABORG+pte_map[p_index];
 
-		p = HTABORG+phys_map[head].pte_index;
-		tlbie(VM_Base+phys_map[head].page_index);
+		tlbie(VM_Base+v_index);
 
 		if (p->C)
 		{
 			p->C = 0;
-			phys_map[head].dirty = 1;
-			continue;
+			changed = 1;
 		}
+	}
+
+	return changed != 0;
+}
+
+static int mmu_referenced(u16 p_index, u16 v_index)
+{
+	int referenced = pte_saved[p_index] & PTE_R;
+
+	pte_saved[p_index] &= ~PTE_R;
+
+	if (pte_map[p_index] != PTE_NONE)
+	{
+		PTE *p = HTABORG+pte_map[p_index];
+
+		tlbie(VM_Base+v_index);
 
 		if (p->R)
 		{
 			p->R = 0;
-			continue;
+			referenced = 1;
 		}
+	}
 
-		p->data[0] = 0;
+	return referenced != 0;
+}
 
-		pmap_head = head+1;
-		return head;
-	}
+static void mmu_map(u16 p_index, u16 v_index, int read_only)
+{
+	if (pte_map[p_index] != PTE_NONE)
+		remove_pte(pte_map[p_index]);
+
+	pte_map[p_index] = insert_pte(p_index, v_index, 0, read_only ? 0b11 : 0b10);
 }
 
-static PTE* StorePTE(PTEG pteg, u32 virtual, u32 physical, u8 WIMG, u8 PP, int secondary)
+static void mmu_unmap(u16 p_index, u16 v_index)
 {
-	int i;
-	PTE p = {{0}};
+	if (pte_map[p_index] != PTE_NONE)
+		remove_pte(pte_map[p_index]);
 
-	p.valid = 1;
-	p.VSID = VM_VSID;
-	p.hash = secondary ? 1:0;
-	p.API = virtual >> 22;
-	p.RPN = physical >> 12;
-	p.WIMG = WIMG;
-	p.PP = PP;
+	pte_saved[p_index] = 0;
+}
+
+static void mmu_clear(u16 p_index, u16 v_index)
+{
+	// clear reference bits
+	mmu_changed(p_index, v_index);
+	mmu_referenced(p_index, v_index);
+	// clear physical memory
+	DCZeroRange(MEM_Base+p_index, PAGE_SIZE);
+}
 
-	for (i=0; i < 8; i++)
+static u32 aram_page_out(u16 p_index, u16 v_index, u32 count)
+{
+	DCFlushRange(MEM_Base+p_index, PAGE_SIZE*count);
+	ARQ_PostRequest(&vm_request, VM_VSID, ARQ_MRAMTOARAM, ARQ_PRIO_LO, v_index*PAGE_SIZE, MEM_Base+p_index, PAGE_SIZE*count);
+	return count;
+}
+
+static void aram_page_in(u16 p_index, u16 v_index)
+{
+	ARQ_PostRequest(&vm_request, VM_VSID, ARQ_ARAMTOMRAM, ARQ_PRIO_HI, v_index*PAGE_SIZE, MEM_Base+p_index, PAGE_SIZE);
+	DCInvalidateRange(MEM_Base+p_index, PAGE_SIZE);
+}
+
+// compress a page into the slab, returns 0 when the store is full
+static int z_store(u16 v_index, const void* src)
+{
+	int length = LZ4Compress(zbuf, PAGE_SIZE-SLAB_GRANULE, src, PAGE_SIZE);
+	const void* data = zbuf;
+	u32 slot;
+
+	// pages that don't shrink are stored as they are
+	if (!length)
 	{
-		if (pteg[i].data[0] == p.data[0])
-		{
-//			printf("Error: address %08x already had a PTE entry\n", virtual);
-//			abort();
-		}
-		else if (pteg[i].valid)
-			continue;
+		length = PAGE_SIZE;
+		data = src;
+	}
 
-		asm volatile("tlbie %0" : : "r"(virtual));
-		pteg[i].data[1] = p.data[1];
-		pteg[i].data[0] = p.data[0];
-//		if (i || secondary)
-//			printf("PTE for address %08x/%08x in PTEG %p index %d (%s)\n", virtual, physical, pteg, i, secondary ? "secondary" : "primary");
-		return pteg+i;
+	// the old copy stays valid until the new one has a home
+	slot = SlabAlloc(length);
+	if (slot == SLAB_NONE)
+		return 0;
+
+	if (zmap[v_index] != SLAB_NONE)
+	{
+		SlabFree(zmap[v_index]);
+		zpages--;
 	}
 
-	return NULL;
+	zmap[v_index] = slot;
+
+	length = (length+31)&~31;
+	DCFlushRange((void*)data, length);
+	ARQ_PostRequest(&vm_request, VM_VSID, ARQ_MRAMTOARAM, ARQ_PRIO_LO, SLAB_OFFSET(slot), (void*)data, length);
+
+	zpages++;
+	return 1;
 }
 
-static PTEG CalcPTEG(u32 virtual, int secondary)
+static u32 z_page_out(u16 p_index, u16 v_index, u32 count)
 {
-	uint32_t segment_index = (virtual >> 12) & 0xFFFF;
-	u32 ptr = MEM_VIRTUAL_TO_PHYSICAL(HTABORG);
-	u32 hash = segment_index ^ VM_VSID;
+	u32 i;
 
-	if (secondary) hash = ~hash;
+	for (i=0; i < count; i++)
+	{
+		if (!z_store(v_index+i, MEM_Base+p_index+i))
+			break;
+	}
 
-	hash &= (HTABMASK << 10) | 0x3FF;
-	ptr |= hash << 6;
+	return i;
+}
 
-	return (PTEG)MEM_PHYSICAL_TO_K0(ptr);
+// a page that doesn't unpack to its full size is cleared rather than
+// handed out half written
+static void z_unpack(u16 p_index, const u8* src, u32 length)
+{
+	if (LZ4Decompress((u8*)(MEM_Base+p_index), PAGE_SIZE, src, length) != PAGE_SIZE)
+	{
+		DCZeroRange(MEM_Base+p_index, PAGE_SIZE);
+		zerrors++;
+	}
 }
 
-static PTE* insert_pte(u16 index, u32 physical, u8 WIMG, u8 PP)
+static void z_page_in(u16 p_index, u16 v_index)
 {
-	PTE *pte;
+	u32 slot = zmap[v_index];
+
+	if (slot == SLAB_NONE)
+	{
+		DCZeroRange(MEM_Base+p_index, PAGE_SIZE);
+		return;
+	}
+
+	if (SLAB_LENGTH(slot) == PAGE_SIZE)
+	{
+		DCInvalidateRange(MEM_Base+p_index, PAGE_SIZE);
+		ARQ_PostRequest(&vm_request, VM_VSID, ARQ_ARAMTOMRAM, ARQ_PRIO_HI, SLAB_OFFSET(slot), MEM_Base+p_index, PAGE_SIZE);
+		DCInvalidateRange(MEM_Base+p_index, PAGE_SIZE);
+		return;
+	}
+
+	DCInvalidateRange(zbuf, SLAB_LENGTH(slot));
+	ARQ_PostRequest(&vm_request, VM_VSID, ARQ_ARAMTOMRAM, ARQ_PRIO_HI, SLAB_OFFSET(slot), zbuf, SLAB_LENGTH(slot));
+	z_unpack(p_index, zbuf, SLAB_LENGTH(slot));
+}
+
+static void prefetch_cb(ARQRequest* req)
+{
+	int i = req - prefetch_request;
+
+	if (prefetch_page[i] == PREFETCH_DROPPED)
+		prefetch_page[i] = 0xFFFF;
+	else
+		prefetch_done[i] = 1;
+}
+
+static int aram_prefetch(u16 p_index, u16 v_index)
+{
+	u32 aram = v_index*PAGE_SIZE, length = PAGE_SIZE;
 	int i;
-	u32 virtual = (u32)(VM_Base+index);
 
-	for (i=0; i < 2; i++)
+	if (zmap)
 	{
-		PTEG pteg = CalcPTEG(virtual, i);
-		pte = StorePTE(pteg, virtual, physical, WIMG, PP, i);
-		if (pte)
-			return pte;
+		if (zmap[v_index] == SLAB_NONE)
+			return 0;
+
+		aram = SLAB_OFFSET(zmap[v_index]);
+		length = SLAB_LENGTH(zmap[v_index]);
 	}
 
-//	printf("Failed to insert PTE for %p\n", VM_Base+index);
-//	abort();
+	for (i=0; i < PREFETCH_SLOTS; i++)
+	{
+		if (prefetch_page[i] != 0xFFFF)
+			continue;
+
+		prefetch_page[i] = p_index;
+		prefetch_done[i] = 0;
+		prefetch_length[i] = length;
+
+		// don't let stale lines get written over the transfer
+		DCInvalidateRange(prefetch_buf[i], length);
+		ARQ_PostRequestAsync(&prefetch_request[i], VM_VSID, ARQ_ARAMTOMRAM, ARQ_PRIO_LO, aram, prefetch_buf[i], length, prefetch_cb);
+		return 1;
+	}
 
-	return NULL;
+	return 0;
 }
 
-static void tlbia(void)
+// the DSI handler and VM_InvalidateAll run with interrupts off so
+// prefetch_cb can't be waited for, a read that hasn't landed is dropped
+// and the pager reads the page itself
+static int aram_wait(u16 p_index)
 {
+	u32 level;
 	int i;
-	for (i=0; i < 64; i++)
-		asm volatile("tlbie %0" :: "r" (i*PAGE_SIZE));
+
+	for (i=0; i < PREFETCH_SLOTS; i++)
+	{
+		if (prefetch_page[i] != p_index)
+			continue;
+
+		_CPU_ISR_Disable(level);
+		if (!prefetch_done[i])
+		{
+			prefetch_page[i] = PREFETCH_DROPPED;
+			_CPU_ISR_Restore(level);
+			return 0;
+		}
+		_CPU_ISR_Restore(level);
+
+		DCInvalidateRange(prefetch_buf[i], prefetch_length[i]);
+		if (prefetch_length[i] < PAGE_SIZE)
+			z_unpack(p_index, prefetch_buf[i], prefetch_length[i]);
+		else
+			memcpy(MEM_Base+p_index, prefetch_buf[i], PAGE_SIZE);
+		prefetch_page[i] = 0xFFFF;
+		return 1;
+	}
+
+	return 0;
 }
 
+static void mem_zero(u16 p_index)
+{
+	DCZeroRange(MEM_Base+p_index, PAGE_SIZE);
+}
+
+static const vm_backend aram_backend =
+{
+	.changed    = mmu_changed,
+	.referenced = mmu_referenced,
+	.map        = mmu_map,
+	.unmap      = mmu_unmap,
+	.page_out   = aram_page_out,
+	.page_in    = aram_page_in,
+	.prefetch   = aram_prefetch,
+	.wait       = aram_wait,
+	.zero       = mem_zero,
+};
+
+static const vm_backend zram_backend =
+{
+	.changed    = mmu_changed,
+	.referenced = mmu_referenced,
+	.map        = mmu_map,
+	.unmap      = mmu_unmap,
+	.page_out   = z_page_out,
+	.page_in    = z_page_in,
+	.prefetch   = aram_prefetch,
+	.wait       = aram_wait,
+	.zero       = mem_zero,
+};
+
 void __exception_sethandler(u32 nExcept, void (*pHndl)());
 extern void default_exceptionhandler();
 extern void dsi_exceptionhandler();
 
-void* VM_Init(size_t VMSize, size_t MEMSize)
+void* VM_InitCompressed(size_t VMSize, size_t MEMSize, size_t StoreSize)
 {
 	u32 i;
 	u16 index, v_index;
@@ -254,48 +500,70 @@ void* VM_Init(size_t VMSize, size_t MEMSize)
 		return NULL;
 	}
 
+	// compress pages once they no longer fit the backing store as they are
+	if (StoreSize < VMSize)
+	{
+		zmap = malloc((VMSize/PAGE_SIZE)*sizeof(u32));
+
+		if (!zmap || !SlabInit(StoreSize))
+		{
+			free(zmap);
+			zmap = NULL;
+			LWP_MutexDestroy(vm_mutex);
+			vm_mutex = LWP_MUTEX_NULL;
+			errno = ENOMEM;
+			return NULL;
+		}
+
+		zmap_size = VMSize/PAGE_SIZE;
+		for (i=0; i < zmap_size; i++)
+			zmap[i] = SLAB_NONE;
+		zpages = 0;
+		zerrors = 0;
+	}
+
 	MEM_Base = (vm_page*)SYS_AllocArenaMemHi(MEMSize, PAGE_SIZE);
 
 //	printf("MEM_Base: %p\n", MEM_Base);
 
 	tlbia();
 	DCZeroRange(MEM_Base, MEMSize);
-	HTABORG = (PTE*)(((u32)MEM_Base+0xFFFF)&~0xFFFF);
+	htabmask = (pmap_max-1) >> 11;
+	HTABORG = (PTE*)(((u32)MEM_Base+PTE_SIZE-1)&~(PTE_SIZE-1));
 //	printf("HTABORG: %p\n", HTABORG);
 
+	vm_pager_init(zmap ? &zram_backend : &aram_backend, pmap_max);
+	stall_ticks = 0;
+
+	for (i=0; i < MAX_PAGES; i++)
+	{
+		pte_map[i] = PTE_NONE;
+		pte_saved[i] = 0;
+	}
+
+	memset(pteg_used, 0, sizeof(pteg_used));
+	memset(pteg_victim, 0, sizeof(pteg_victim));
+
+	for (i=0; i < PREFETCH_SLOTS; i++)
+		prefetch_page[i] = 0xFFFF;
+
 	// initial commit: map pmap_max pages to fill PTEs with valid RPNs
 	for (index=0,v_index=0; index<pmap_max; ++index,++v_index)
 	{
 		if ((PTE*)(MEM_Base+index) == HTABORG)
 		{
 //			printf("p_map hole: %u -> %u\n", index, index+(PTE_SIZE/PAGE_SIZE));
-			for (i=0; i<(PTE_SIZE/PAGE_SIZE); ++i,++index)
-				phys_map[index].valid = 0;
+			index += PTE_SIZE/PAGE_SIZE;
 
 			--index, --v_index;
 			continue;
 		}
 
-		phys_map[index].valid = 1;
-		phys_map[index].locked = 0;
-		phys_map[index].dirty = 0;
-		phys_map[index].page_index = v_index;
-		phys_map[index].pte_index = insert_pte(v_index, MEM_VIRTUAL_TO_PHYSICAL(MEM_Base+index), 0, 0b10) - HTABORG;
-		virt_map[v_index].committed = 0;
-		virt_map[v_index].p_map_index = index;
-	}
-
-	// all indexes up to 65536
-	for (; v_index; ++v_index)
-	{
-		virt_map[v_index].committed = 0;
-		virt_map[v_index].p_map_index = pmap_max;
+		vm_pager_map(index, v_index);
 	}
 
-	pmap_head = 0;
-
 	// set SDR1
-	mtspr(25, MEM_VIRTUAL_TO_PHYSICAL(HTABORG)|HTABMASK);
+	mtspr(25, MEM_VIRTUAL_TO_PHYSICAL(HTABORG)|htabmask);
 //	printf("SDR1: %08x\n", MEM_VIRTUAL_TO_PHYSICAL(HTABORG));
 	// enable SR
 	asm volatile("mtsrin %0,%1" :: "r"(VM_VSID), "r"(VM_Base));
@@ -307,6 +575,11 @@ void* VM_Init(size_t VMSize, size_t MEMSize)
 	return VM_Base;
 }
 
+void* VM_Init(size_t VMSize, size_t MEMSize)
+{
+	return VM_InitCompressed(VMSize, MEMSize, VMSize);
+}
+
 void VM_Deinit(void)
 {
 	if (--vm_initialized)
@@ -326,7 +599,6 @@ void VM_Deinit(void)
 
 void VM_InvalidateAll(void)
 {
-	u16 index;
 	u32 irq;
 
 	if (!vm_initialized)
@@ -338,31 +610,23 @@ void VM_InvalidateAll(void)
 
 	tlbia();
 
-	for (index=0; index < pmap_max; index++)
+	vm_pager_reset(mmu_clear);
+
+	if (zmap)
 	{
-		if (phys_map[index].valid)
-		{
-			PTE *p = HTABORG+phys_map[index].pte_index;
+		u32 i;
 
-			// clear reference bits
-			p->R = 0;
-			p->C = 0;
-			// unlock
-			phys_map[index].locked = 0;
-			// page is clean
-			phys_map[index].dirty = 0;
-			// clear physical memory
-			DCZeroRange(MEM_Base+index, PAGE_SIZE);
+		for (i=0; i < zmap_size; i++)
+		{
+			if (zmap[i] != SLAB_NONE)
+			{
+				SlabFree(zmap[i]);
+				zmap[i] = SLAB_NONE;
+				zpages--;
+			}
 		}
-
-		virt_map[index].committed = 0;
 	}
 
-	for (; index; index++)
-		virt_map[index].committed = 0;
-
-	pmap_head = 0;
-
 	_CPU_ISR_Restore(irq);
 
 //	printf("VM was invalidated\n");
@@ -370,91 +634,239 @@ void VM_InvalidateAll(void)
 	LWP_MutexUnlock(vm_mutex);
 }
 
-int vm_dsi_handler(u32 DSISR, u32 DAR)
+void VM_Seal(void* addr, size_t size, int sealed)
 {
-	u16 virt_index;
-	u16 phys_index;
-	u16 flush_v_index;
+	u16 v_index, v_end;
 
-	if (DAR<(u32)VM_Base || DAR>=0x80000000)
+	if (!vm_initialized || !size)
+		return;
+
+	v_index = (vm_page*)((u32)addr&PAGE_MASK) - VM_Base;
+	v_end = (vm_page*)(((u32)addr+size-1)&PAGE_MASK) - VM_Base;
+
+	LWP_MutexLock(vm_mutex);
+
+	do
+		vm_pager_seal(v_index, sealed);
+	while (v_index++ != v_end);
+
+	LWP_MutexUnlock(vm_mutex);
+}
+
+size_t VM_Write(void* dst, const void* src, size_t size)
+{
+	u32 head, body, offset;
+	u16 v_index;
+
+	if (!vm_initialized)
 		return 0;
-	if ((DSISR&~0x02000000)!=0x40000000)
+
+	// unaligned parts go through the MMU like any other store
+	head = -(u32)dst & (PAGE_SIZE-1);
+	if (head > size)
+		head = size;
+	memcpy(dst, src, head);
+
+	// ARQ needs a 32-byte aligned source
+	body = ((u32)src+head) & 31 ? 0 : (size-head) & PAGE_MASK;
+
+	if (body)
+	{
+		v_index = (vm_page*)((u8*)dst+head) - VM_Base;
+
+		LWP_MutexLock(vm_mutex);
+
+		for (offset=0; offset < body; offset += PAGE_SIZE)
+			vm_pager_discard(v_index + offset/PAGE_SIZE);
+
+		if (zmap)
+		{
+			for (offset=0; offset < body; offset += PAGE_SIZE)
+			{
+				if (!z_store(v_index + offset/PAGE_SIZE, (const u8*)src+head+offset))
+					break;
+			}
+		}
+		else
+		{
+			offset = body;
+			DCFlushRange((u8*)src+head, body);
+			ARQ_PostRequest(&vm_request, VM_VSID, ARQ_MRAMTOARAM, ARQ_PRIO_HI, v_index*PAGE_SIZE, (u8*)src+head, body);
+		}
+
+		LWP_MutexUnlock(vm_mutex);
+
+		// the store is full, report how much made it
+		if (offset < body)
+			return head+offset;
+	}
+
+	head += body;
+	memcpy((u8*)dst+head, (const u8*)src+head, size-head);
+
+	return size;
+}
+
+u32 VM_Clean(u32 pages)
+{
+	u32 cleaned;
+
+	if (!vm_initialized || !pages)
 		return 0;
-	if (!vm_initialized)
+
+	// never hold up a fault being serviced
+	if (LWP_MutexTryLock(vm_mutex) != 0)
 		return 0;
 
+	cleaned = vm_pager_clean(pages);
+
+	LWP_MutexUnlock(vm_mutex);
+
+	return cleaned;
+}
+
+int VM_Lock(void* addr, size_t size, int locked)
+{
+	u16 v_index, v_end;
+	int ret = 1;
+
+	if (!vm_initialized || !size)
+		return 0;
+
+	v_index = (vm_page*)((u32)addr&PAGE_MASK) - VM_Base;
+	v_end = (vm_page*)(((u32)addr+size-1)&PAGE_MASK) - VM_Base;
+
 	LWP_MutexLock(vm_mutex);
 
-	DAR &= ~0xFFF;
-	virt_index = (vm_page*)DAR - VM_Base;
+	do
+		ret &= vm_pager_lock(v_index, locked);
+	while (v_index++ != v_end);
 
-	phys_index = locate_oldest();
+	LWP_MutexUnlock(vm_mutex);
 
-	// purge phys_index if it's dirty
-	if (phys_map[phys_index].dirty)
-	{
-		unsigned int pages_to_flush;
+	return ret;
+}
 
-		flush_v_index = phys_map[phys_index].page_index;
-		virt_map[flush_v_index].committed = 1;
-		// mark this virtual page as unmapped
-		virt_map[flush_v_index].p_map_index = pmap_max;
-		phys_map[phys_index].dirty = 0;
+void VM_ProfileStart(void)
+{
+	if (!vm_initialized || heat)
+		return;
 
-		// optimize by flushing up to four dirty pages at once
-		for (pages_to_flush=1; pages_to_flush < 4; pages_to_flush++)
-		{
-			PTE *p;
+	heat = calloc(65536, sizeof(u16));
+	heat_samples = 0;
+}
 
-			// check for end of physical mem
-			if (phys_index+pages_to_flush >= pmap_max)
-				break;
+void VM_ProfileStop(void)
+{
+	if (!heat)
+		return;
 
-			// check for p_map hole
-			if (!phys_map[pmap_head].valid)
-				break;
+	LWP_MutexLock(vm_mutex);
+	free(heat);
+	heat = NULL;
+	LWP_MutexUnlock(vm_mutex);
+}
 
-			// make sure physical pages hold consecutive virtual pages
-			if (phys_map[pmap_head].page_index != flush_v_index+pages_to_flush)
-				break;
+void VM_Sample(void)
+{
+	if (!heat)
+		return;
 
-			// page should only be flushed if it's dirty
-			p = HTABORG+phys_map[pmap_head].pte_index;
-			if (p->C)
-			{
-				tlbie(VM_Base+phys_map[pmap_head].page_index);
-				p->C = 0;
-			}
-			else if (!phys_map[pmap_head].dirty)
-				break;
+	LWP_MutexLock(vm_mutex);
+	vm_pager_sample(heat);
+	heat_samples++;
+	LWP_MutexUnlock(vm_mutex);
+}
 
-			virt_map[flush_v_index+pages_to_flush].committed = 1;
-			phys_map[pmap_head].dirty = 0;
-			pmap_head++;
-		}
+u32 VM_PinHottest(u32 pages)
+{
+	u32 pinned;
+
+	if (!heat || !pages)
+		return 0;
+
+	LWP_MutexLock(vm_mutex);
+	pinned = vm_pager_pin_hottest(heat, pages);
+	LWP_MutexUnlock(vm_mutex);
+
+	return pinned;
+}
+
+int VM_DumpHeat(const char* file)
+{
+	FILE *fp;
+	u32 index;
+
+	if (!heat || !file)
+		return 0;
+	if (!(fp = fopen(file, "w")))
+		return 0;
 
-		DCFlushRange(MEM_Base+phys_index, PAGE_SIZE*pages_to_flush);
-		ARQ_PostRequest(&vm_request, VM_VSID, ARQ_MRAMTOARAM, ARQ_PRIO_LO, flush_v_index*PAGE_SIZE, MEM_Base+phys_index, PAGE_SIZE*pages_to_flush);
-//		printf("VM page %d was purged (%d)\n", phys_map[phys_index].page_index, pages_to_flush);
+	fprintf(fp, "address,samples,hits,pinned\n");
+
+	for (index=0; index < 65536; index++)
+	{
+		if (heat[index])
+			fprintf(fp, "0x%08x,%u,%u,%d\n", (u32)(VM_Base+index), heat_samples, heat[index], vm_pager_locked(index));
 	}
 
-	// fetch virtual_index if it has been previously committed
-	if (virt_map[virt_index].committed)
+	fclose(fp);
+	return 1;
+}
+
+int vm_dsi_handler(u32 DSISR, u32 DAR)
+{
+	u64 start;
+	u16 virt_index;
+
+	if (DAR<(u32)VM_Base || DAR>=0x80000000)
+		return 0;
+	if (!vm_initialized)
+		return 0;
+
+	// store to a sealed page, make it writable again
+	if (DSISR==0x0A000000)
 	{
-		ARQ_PostRequest(&vm_request, VM_VSID, ARQ_ARAMTOMRAM, ARQ_PRIO_HI, virt_index*PAGE_SIZE, MEM_Base+phys_index, PAGE_SIZE);
-		DCInvalidateRange(MEM_Base+phys_index, PAGE_SIZE);
-//		printf("VM page %d was fetched\n", virt_index);
+		LWP_MutexLock(vm_mutex);
+		vm_pager_seal((vm_page*)(DAR&~0xFFF) - VM_Base, 0);
+		LWP_MutexUnlock(vm_mutex);
+		return 1;
 	}
-	else
-		DCZeroRange(MEM_Base+phys_index, PAGE_SIZE);
 
-//	printf("VM page %u (0x%08x) replaced page %u (%p) @ %p\n", virt_index, DAR, phys_map[phys_index].page_index, VM_Base+phys_map[phys_index].page_index, MEM_Base+phys_index);
+	if ((DSISR&~0x02000000)!=0x40000000)
+		return 0;
+
+	LWP_MutexLock(vm_mutex);
+
+	start = gettime();
+
+	DAR &= ~0xFFF;
+	virt_index = (vm_page*)DAR - VM_Base;
 
-	virt_map[virt_index].p_map_index = phys_index;
-	phys_map[phys_index].page_index = virt_index;
-	phys_map[phys_index].pte_index = insert_pte(virt_index, MEM_VIRTUAL_TO_PHYSICAL(MEM_Base+phys_index), 0, 0b10) - HTABORG;
+	vm_pager_fault(virt_index);
+
+	stall_ticks += diff_ticks(start, gettime());
 
 	LWP_MutexUnlock(vm_mutex);
 
 	return 1;
 }
+
+void VM_GetStats(vm_stats *stats)
+{
+	if (!vm_initialized)
+	{
+		memset(stats, 0, sizeof(*stats));
+		return;
+	}
+
+	LWP_MutexLock(vm_mutex);
+
+	vm_pager_get_stats(stats);
+	stats->stall_ticks = stall_ticks;
+	stats->store_pages = zpages;
+	stats->store_errors = zerrors;
+	stats->store_bytes = zmap ? SlabUsed() : 0;
+
+	LWP_MutexUnlock(vm_mutex);
+}
@@ -3,16 +3,47 @@
  * without explicit permission from the author.
  */
 
+#include "vm_pager.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 void* VM_Init(size_t VMSize, size_t MEMSize);
+// pages are LZ4 compressed into StoreSize bytes of ARAM when VMSize doesn't fit
+void* VM_InitCompressed(size_t VMSize, size_t MEMSize, size_t StoreSize);
 void VM_Deinit(void);
 
 // clears entire VM range to zero, unlocks any locked pages
 void VM_InvalidateAll(void);
 
+// sealed pages are mapped read-only and dropped instead of written back,
+// a store makes the page writable again
+void VM_Seal(void* addr, size_t size, int sealed);
+
+// copies straight to backing store, src must be 32-byte aligned,
+// returns less than size when the backing store is full
+size_t VM_Write(void* dst, const void* src, size_t size);
+
+// write back dirty pages before they are evicted, call when idle,
+// returns the number of pages written
+uint32_t VM_Clean(uint32_t pages);
+
+// locked pages are never evicted, fails once half of physical memory is locked
+int VM_Lock(void* addr, size_t size, int locked);
+
+// sample referenced bits per page on every VM_Sample() call
+void VM_ProfileStart(void);
+void VM_ProfileStop(void);
+void VM_Sample(void);
+// lock the most referenced pages seen so far
+uint32_t VM_PinHottest(uint32_t pages);
+// write the per-page heat map as CSV
+int VM_DumpHeat(const char* file);
+
+// fault and transfer counters since VM_Init
+void VM_GetStats(vm_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,685 @@
+/* Copyright 2013 tueidj All Rights Reserved
+ * This code may not be used in any project
+ * without explicit permission from the author.
+ */
+
+#include <string.h>
+
+#include "vm_pager.h"
+
+// most pages read ahead of a detected stream
+#define PREFETCH_MAX     8
+// largest stride in pages still treated as a stream
+#define STRIDE_MAX       16
+// frames ahead of the clock hand kept clean by vm_pager_clean()
+#define CLEAN_AHEAD      64
+
+// keeps a record of each currently mapped page
+typedef union
+{
+	uint32_t data;
+	struct
+	{
+		// is this a valid physical page?
+		uint32_t valid      :  1;
+		// can this page be flushed?
+		uint32_t locked     :  1;
+		// does this page contain changes?
+		uint32_t dirty      :  1;
+		// was this page discarded and not reused yet?
+		uint32_t free       :  1;
+		// read ahead but not mapped yet?
+		uint32_t staged     :  1;
+		// passed over once by the clock while staged?
+		uint32_t aged       :  1;
+		// referenced bit taken by the profiler
+		uint32_t accessed   :  1;
+		uint32_t            :  9;
+		// virtual page index for this physical page
+		uint32_t page_index : 16;
+	};
+} p_map;
+
+// maps VM addresses to mapped pages
+typedef struct
+{
+	// data must be fetched when paging in?
+	uint16_t committed  :  1;
+	// physical page index for this virtual page
+	uint16_t p_map_index: 13;
+	// read-only, dropped instead of flushed?
+	uint16_t sealed     :  1;
+} vm_map;
+
+static p_map phys_map[4096];
+static vm_map virt_map[65536];
+static uint16_t pmap_max, pmap_head;
+static uint16_t locked_pages;
+
+static const vm_backend *vm_ops;
+static vm_stats stats;
+
+// fault stream detector
+static struct
+{
+	uint16_t last;
+	int32_t stride;
+	uint32_t run;
+	uint32_t window;
+} prefetcher;
+
+static int resident(uint16_t v_index)
+{
+	uint16_t p_index = virt_map[v_index].p_map_index;
+
+	if (p_index >= pmap_max || !phys_map[p_index].valid || phys_map[p_index].free || phys_map[p_index].staged)
+		return 0;
+
+	return phys_map[p_index].page_index == v_index;
+}
+
+static int staged(uint16_t v_index)
+{
+	uint16_t p_index = virt_map[v_index].p_map_index;
+
+	if (p_index >= pmap_max || !phys_map[p_index].staged)
+		return 0;
+
+	return phys_map[p_index].page_index == v_index;
+}
+
+// with dirty_ok clear a dirty victim is left in place and pmap_max
+// returned instead
+static uint16_t locate_oldest(int dirty_ok)
+{
+	uint16_t head = pmap_head;
+
+	for(;;++head)
+	{
+		uint16_t v_index;
+
+		if (head >= pmap_max)
+			head = 0;
+
+		if (!phys_map[head].valid || phys_map[head].locked)
+			continue;
+
+		// discarded pages have no mapping left to remove
+		if (phys_map[head].free)
+		{
+			phys_map[head].free = 0;
+			pmap_head = head+1;
+			return head;
+		}
+
+		v_index = phys_map[head].page_index;
+
+		// read-ahead pages get one full sweep to be used
+		if (phys_map[head].staged)
+		{
+			if (!phys_map[head].aged)
+			{
+				phys_map[head].aged = 1;
+				continue;
+			}
+
+			vm_ops->wait(head);
+			phys_map[head].staged = 0;
+			phys_map[head].aged = 0;
+			virt_map[v_index].p_map_index = pmap_max;
+
+			stats.prefetch_wasted++;
+			if (prefetcher.window > 1)
+				prefetcher.window >>= 1;
+
+			pmap_head = head+1;
+			return head;
+		}
+
+		// sealed pages are read-only so they can never be changed
+		if (!virt_map[v_index].sealed && vm_ops->changed(head, v_index))
+		{
+			phys_map[head].dirty = 1;
+			continue;
+		}
+
+		if (vm_ops->referenced(head, v_index))
+			phys_map[head].accessed = 1;
+
+		if (phys_map[head].accessed)
+		{
+			phys_map[head].accessed = 0;
+			continue;
+		}
+
+		if (!dirty_ok && phys_map[head].dirty)
+		{
+			pmap_head = head;
+			return pmap_max;
+		}
+
+		if (virt_map[v_index].sealed)
+			stats.drops++;
+
+		vm_ops->unmap(head, v_index);
+
+		pmap_head = head+1;
+		return head;
+	}
+}
+
+void vm_pager_init(const vm_backend *backend, uint16_t frames)
+{
+	uint32_t v_index;
+
+	vm_ops = backend;
+	pmap_max = frames;
+	pmap_head = 0;
+	locked_pages = 0;
+
+	memset(phys_map, 0, sizeof(phys_map));
+
+	for (v_index=0; v_index < 65536; ++v_index)
+	{
+		virt_map[v_index].committed = 0;
+		virt_map[v_index].p_map_index = pmap_max;
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	memset(&prefetcher, 0, sizeof(prefetcher));
+	prefetcher.window = 2;
+}
+
+void vm_pager_map(uint16_t p_index, uint16_t v_index)
+{
+	phys_map[p_index].valid = 1;
+	phys_map[p_index].locked = 0;
+	phys_map[p_index].dirty = 0;
+	phys_map[p_index].free = 0;
+	phys_map[p_index].accessed = 0;
+	phys_map[p_index].page_index = v_index;
+	virt_map[v_index].committed = 0;
+	virt_map[v_index].sealed = 0;
+	virt_map[v_index].p_map_index = p_index;
+
+	vm_ops->map(p_index, v_index, 0);
+}
+
+void vm_pager_reset(void (*clear)(uint16_t p_index, uint16_t v_index))
+{
+	uint32_t index;
+
+	for (index=0; index < pmap_max; index++)
+	{
+		if (phys_map[index].staged)
+		{
+			vm_ops->wait(index);
+			phys_map[index].staged = 0;
+			phys_map[index].aged = 0;
+			phys_map[index].free = 1;
+		}
+		else if (phys_map[index].valid && !phys_map[index].free)
+		{
+			// unlock
+			phys_map[index].locked = 0;
+			// page is clean
+			phys_map[index].dirty = 0;
+			clear(index, phys_map[index].page_index);
+		}
+	}
+
+	for (index=0; index < 65536; index++)
+	{
+		virt_map[index].committed = 0;
+		virt_map[index].sealed = 0;
+	}
+
+	locked_pages = 0;
+	prefetcher.run = 0;
+
+	pmap_head = 0;
+}
+
+// write back count frames from p_index, pages the backing store turns
+// away stay dirty so their changes aren't lost
+static uint32_t write_back(uint16_t p_index, uint16_t v_index, uint32_t count)
+{
+	uint32_t i, stored;
+
+	stored = vm_ops->page_out(p_index, v_index, count);
+
+	for (i=0; i < count; i++)
+	{
+		if (i < stored)
+			virt_map[v_index+i].committed = 1;
+		phys_map[p_index+i].dirty = i >= stored;
+	}
+
+	if (stored < count)
+		stats.store_full++;
+
+	stats.pages_out += stored;
+	stats.flushes++;
+
+	return stored;
+}
+
+// take the oldest page and write it back if needed
+static uint16_t reclaim(void)
+{
+	uint16_t phys_index;
+	uint16_t flush_v_index;
+	uint32_t victims = 0;
+
+	phys_index = locate_oldest(1);
+
+	// purge phys_index if it's dirty, move on to the next page when
+	// the backing store can't take it
+	while (phys_map[phys_index].dirty)
+	{
+		unsigned int pages_to_flush;
+
+		flush_v_index = phys_map[phys_index].page_index;
+
+		// optimize by flushing up to four dirty pages at once
+		for (pages_to_flush=1; pages_to_flush < 4; pages_to_flush++)
+		{
+			// check for end of physical mem
+			if (phys_index+pages_to_flush >= pmap_max)
+				break;
+
+			// check for p_map hole
+			if (!phys_map[pmap_head].valid || phys_map[pmap_head].free || phys_map[pmap_head].staged)
+				break;
+
+			// make sure physical pages hold consecutive virtual pages
+			if (phys_map[pmap_head].page_index != flush_v_index+pages_to_flush)
+				break;
+
+			// page should only be flushed if it's dirty
+			if (virt_map[flush_v_index+pages_to_flush].sealed)
+				break;
+			if (!vm_ops->changed(pmap_head, phys_map[pmap_head].page_index) && !phys_map[pmap_head].dirty)
+				break;
+
+			pmap_head++;
+		}
+
+		stats.dirty_reclaims++;
+
+		if (write_back(phys_index, flush_v_index, pages_to_flush))
+		{
+			// mark this virtual page as unmapped
+			virt_map[flush_v_index].p_map_index = pmap_max;
+			break;
+		}
+
+		// every frame has been tried, evict the page and lose its changes
+		if (++victims >= pmap_max)
+		{
+			phys_map[phys_index].dirty = 0;
+			virt_map[flush_v_index].p_map_index = pmap_max;
+			stats.store_lost++;
+			break;
+		}
+
+		// still resident, the next fault on it only remaps it
+		phys_index = locate_oldest(1);
+	}
+
+	return phys_index;
+}
+
+// write back dirty pages the clock hand is about to reach so that
+// reclaim() finds clean frames, returns the number of pages written
+uint32_t vm_pager_clean(uint32_t pages)
+{
+	uint32_t scanned, cleaned = 0;
+	uint16_t head = pmap_head;
+
+	for (scanned=0; scanned < CLEAN_AHEAD && scanned < pmap_max && cleaned < pages; scanned++, head++)
+	{
+		uint16_t v_index;
+		uint32_t count, stored;
+
+		if (head >= pmap_max)
+			head = 0;
+
+		if (!phys_map[head].valid || phys_map[head].locked || phys_map[head].free || phys_map[head].staged)
+			continue;
+
+		v_index = phys_map[head].page_index;
+
+		if (virt_map[v_index].sealed)
+			continue;
+		if (!vm_ops->changed(head, v_index) && !phys_map[head].dirty)
+			continue;
+
+		// extend over following frames that hold the next dirty pages
+		for (count=1; count < 4 && cleaned+count < pages; count++)
+		{
+			uint16_t next = head+count;
+
+			if (next >= pmap_max)
+				break;
+			if (!phys_map[next].valid || phys_map[next].locked || phys_map[next].free || phys_map[next].staged)
+				break;
+			if (phys_map[next].page_index != v_index+count)
+				break;
+			if (virt_map[v_index+count].sealed)
+				break;
+			if (!vm_ops->changed(next, v_index+count) && !phys_map[next].dirty)
+				break;
+		}
+
+		// the pages stay mapped, a later store sets the changed bit again
+		stored = write_back(head, v_index, count);
+		stats.cleaned += stored;
+		cleaned += stored;
+
+		if (stored < count)
+			break;
+
+		scanned += count-1;
+		head += count-1;
+	}
+
+	return cleaned;
+}
+
+// read ahead along a run of faults with a constant stride
+static void prefetch(uint16_t virt_index)
+{
+	int32_t stride = virt_index - prefetcher.last;
+	uint32_t i;
+
+	if (stride && stride == prefetcher.stride)
+		prefetcher.run++;
+	else
+	{
+		prefetcher.stride = stride;
+		prefetcher.run = 0;
+	}
+
+	prefetcher.last = virt_index;
+
+	if (!prefetcher.run || stride > STRIDE_MAX || stride < -STRIDE_MAX)
+		return;
+
+	for (i=1; i <= prefetcher.window; i++)
+	{
+		int32_t next = virt_index + stride*(int32_t)i;
+		uint16_t phys_index;
+
+		if (next < 0 || next > 0xFFFF)
+			break;
+
+		if (resident(next) || staged(next))
+			continue;
+
+		// nothing to read for pages that were never written
+		if (!virt_map[next].committed)
+			break;
+
+		// a read-ahead isn't worth a synchronous write-back
+		phys_index = locate_oldest(0);
+		if (phys_index >= pmap_max)
+			break;
+
+		if (!vm_ops->prefetch(phys_index, next))
+		{
+			// no transfer slot left, the page stays free
+			phys_map[phys_index].free = 1;
+			break;
+		}
+
+		phys_map[phys_index].staged = 1;
+		phys_map[phys_index].aged = 0;
+		phys_map[phys_index].page_index = next;
+		virt_map[next].p_map_index = phys_index;
+		stats.prefetches++;
+	}
+}
+
+// bring virt_index in and map it
+static uint16_t fill(uint16_t virt_index)
+{
+	uint16_t phys_index;
+
+	if (staged(virt_index))
+	{
+		// already read ahead, read it now if it hasn't landed yet
+		phys_index = virt_map[virt_index].p_map_index;
+
+		phys_map[phys_index].staged = 0;
+		phys_map[phys_index].aged = 0;
+
+		if (vm_ops->wait(phys_index))
+		{
+			stats.prefetch_hits++;
+			if (prefetcher.window < PREFETCH_MAX)
+				prefetcher.window++;
+		}
+		else
+		{
+			vm_ops->page_in(phys_index, virt_index);
+			stats.pages_in++;
+		}
+	}
+	else
+	{
+		phys_index = reclaim();
+
+		// fetch virtual_index if it has been previously committed
+		if (virt_map[virt_index].committed)
+		{
+			vm_ops->page_in(phys_index, virt_index);
+			stats.pages_in++;
+		}
+		else
+		{
+			vm_ops->zero(phys_index);
+			stats.zero_fills++;
+		}
+
+		virt_map[virt_index].p_map_index = phys_index;
+		phys_map[phys_index].page_index = virt_index;
+	}
+
+	vm_ops->map(phys_index, virt_index, virt_map[virt_index].sealed);
+
+	return phys_index;
+}
+
+uint16_t vm_pager_fault(uint16_t virt_index)
+{
+	uint16_t phys_index;
+
+	// the page is still here, only its mapping was pushed out
+	if (resident(virt_index))
+	{
+		phys_index = virt_map[virt_index].p_map_index;
+		vm_ops->map(phys_index, virt_index, virt_map[virt_index].sealed);
+		stats.remaps++;
+		return phys_index;
+	}
+
+	phys_index = fill(virt_index);
+
+	stats.faults++;
+	prefetch(virt_index);
+
+	return phys_index;
+}
+
+int vm_pager_lock(uint16_t v_index, int locked)
+{
+	uint16_t p_index;
+
+	if (!resident(v_index))
+	{
+		if (!locked)
+			return 1;
+		if (locked_pages >= pmap_max/2)
+			return 0;
+
+		fill(v_index);
+	}
+
+	p_index = virt_map[v_index].p_map_index;
+
+	if (phys_map[p_index].locked == !!locked)
+		return 1;
+
+	// always leave half of physical memory for paging
+	if (locked && locked_pages >= pmap_max/2)
+		return 0;
+
+	phys_map[p_index].locked = !!locked;
+	locked_pages += locked ? 1 : -1;
+
+	return 1;
+}
+
+int vm_pager_locked(uint16_t v_index)
+{
+	return resident(v_index) && phys_map[virt_map[v_index].p_map_index].locked;
+}
+
+void vm_pager_sample(uint16_t *heat)
+{
+	uint32_t index;
+
+	for (index=0; index < pmap_max; index++)
+	{
+		uint16_t v_index = phys_map[index].page_index;
+
+		if (!phys_map[index].valid || phys_map[index].free || phys_map[index].staged)
+			continue;
+
+		// keep the bit for the clock
+		if (vm_ops->referenced(index, v_index))
+		{
+			phys_map[index].accessed = 1;
+
+			if (heat[v_index] != 0xFFFF)
+				heat[v_index]++;
+		}
+	}
+}
+
+uint32_t vm_pager_pin_hottest(const uint16_t *heat, uint32_t pages)
+{
+	static uint32_t histogram[1024];
+	uint32_t index, level, count = 0, pinned = 0;
+
+	memset(histogram, 0, sizeof(histogram));
+
+	for (index=0; index < 65536; index++)
+		histogram[heat[index] < 1023 ? heat[index] : 1023]++;
+
+	// find the lowest heat where everything hotter still fits
+	for (level=1023; level; level--)
+	{
+		if (count+histogram[level] > pages)
+			break;
+		count += histogram[level];
+	}
+
+	for (index=0; index < 65536 && pinned < pages; index++)
+	{
+		uint32_t value = heat[index] < 1023 ? heat[index] : 1023;
+
+		if (value > level)
+		{
+			if (!vm_pager_lock(index, 1))
+				return pinned;
+			pinned++;
+		}
+	}
+
+	// split the remaining budget within the boundary level
+	for (index=0; index < 65536 && level && pinned < pages; index++)
+	{
+		uint32_t value = heat[index] < 1023 ? heat[index] : 1023;
+
+		if (value == level)
+		{
+			if (!vm_pager_lock(index, 1))
+				return pinned;
+			pinned++;
+		}
+	}
+
+	return pinned;
+}
+
+void vm_pager_seal(uint16_t v_index, int sealed)
+{
+	uint16_t p_index = virt_map[v_index].p_map_index;
+
+	if (virt_map[v_index].sealed == !!sealed)
+		return;
+
+	virt_map[v_index].sealed = !!sealed;
+
+	if (!resident(v_index))
+		return;
+
+	// write back outstanding changes before dropping write access, a
+	// page the backing store can't take has to stay writable
+	if (sealed && (vm_ops->changed(p_index, v_index) || phys_map[p_index].dirty))
+	{
+		if (!write_back(p_index, v_index, 1))
+		{
+			virt_map[v_index].sealed = 0;
+			return;
+		}
+	}
+
+	vm_ops->unmap(p_index, v_index);
+	vm_ops->map(p_index, v_index, sealed);
+}
+
+void vm_pager_discard(uint16_t v_index)
+{
+	if (staged(v_index))
+	{
+		uint16_t p_index = virt_map[v_index].p_map_index;
+
+		vm_ops->wait(p_index);
+
+		phys_map[p_index].staged = 0;
+		phys_map[p_index].aged = 0;
+		phys_map[p_index].free = 1;
+	}
+	else if (resident(v_index))
+	{
+		uint16_t p_index = virt_map[v_index].p_map_index;
+
+		vm_ops->changed(p_index, v_index);
+		vm_ops->referenced(p_index, v_index);
+		vm_ops->unmap(p_index, v_index);
+
+		if (phys_map[p_index].locked)
+			locked_pages--;
+
+		phys_map[p_index].locked = 0;
+		phys_map[p_index].dirty = 0;
+		phys_map[p_index].free = 1;
+	}
+
+	virt_map[v_index].committed = 1;
+	virt_map[v_index].sealed = 0;
+	virt_map[v_index].p_map_index = pmap_max;
+}
+
+void vm_pager_get_stats(vm_stats *out)
+{
+	*out = stats;
+}
+
+void vm_pager_clear_stats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+}
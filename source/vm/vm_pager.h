@@ -0,0 +1,108 @@
+/* Copyright 2013 tueidj All Rights Reserved
+ * This code may not be used in any project
+ * without explicit permission from the author.
+ */
+
+#ifndef __VM_PAGER_H__
+#define __VM_PAGER_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// everything the pager needs from the platform, indexed by physical
+// page (p_index) and virtual page (v_index)
+typedef struct
+{
+	// test and clear the hardware changed bit of a mapped page
+	int (*changed)(uint16_t p_index, uint16_t v_index);
+	// test and clear the hardware referenced bit of a mapped page
+	int (*referenced)(uint16_t p_index, uint16_t v_index);
+	// make v_index accessible through p_index
+	void (*map)(uint16_t p_index, uint16_t v_index, int read_only);
+	// remove the mapping of p_index
+	void (*unmap)(uint16_t p_index, uint16_t v_index);
+	// write count consecutive pages starting at p_index to backing store,
+	// returns how many leading pages were stored
+	uint32_t (*page_out)(uint16_t p_index, uint16_t v_index, uint32_t count);
+	// read a page from backing store
+	void (*page_in)(uint16_t p_index, uint16_t v_index);
+	// start reading a page in the background, returns 0 when busy
+	int (*prefetch)(uint16_t p_index, uint16_t v_index);
+	// take a finished background read into p_index, returns 0 when it
+	// hasn't landed yet and was dropped
+	int (*wait)(uint16_t p_index);
+	// clear a physical page
+	void (*zero)(uint16_t p_index);
+} vm_backend;
+
+typedef struct
+{
+	// page faults serviced
+	uint32_t faults;
+	// pages read from backing store
+	uint32_t pages_in;
+	// pages written to backing store
+	uint32_t pages_out;
+	// backing store write requests
+	uint32_t flushes;
+	// pages cleared instead of read
+	uint32_t zero_fills;
+	// sealed pages evicted without write-back
+	uint32_t drops;
+	// pages read ahead of a fault stream
+	uint32_t prefetches;
+	// faults served by a page read ahead
+	uint32_t prefetch_hits;
+	// pages read ahead and evicted unused
+	uint32_t prefetch_wasted;
+	// faults on resident pages that lost their mapping
+	uint32_t remaps;
+	// evictions that had to write back on the fault path
+	uint32_t dirty_reclaims;
+	// pages written back ahead of time by the cleaner
+	uint32_t cleaned;
+	// write-backs the backing store had no room for
+	uint32_t store_full;
+	// dirty pages evicted unsaved when no frame could be written back
+	uint32_t store_lost;
+	// time spent servicing faults, filled in by the platform
+	uint64_t stall_ticks;
+	// pages held by the compressed store and the bytes they take up
+	uint32_t store_pages;
+	uint32_t store_bytes;
+	// stored pages that failed to unpack and were cleared
+	uint32_t store_errors;
+} vm_stats;
+
+void vm_pager_init(const vm_backend *backend, uint16_t frames);
+// add an initial mapping, frames not mapped here are never used
+void vm_pager_map(uint16_t p_index, uint16_t v_index);
+// forget all page contents and unlock every page
+void vm_pager_reset(void (*clear)(uint16_t p_index, uint16_t v_index));
+// service a fault on v_index, returns the physical page now backing it
+uint16_t vm_pager_fault(uint16_t v_index);
+// sealed pages are mapped read-only and never written back
+void vm_pager_seal(uint16_t v_index, int sealed);
+// drop any resident copy of v_index, the caller fills backing store itself
+void vm_pager_discard(uint16_t v_index);
+// write back up to pages dirty pages ahead of the clock hand
+uint32_t vm_pager_clean(uint32_t pages);
+// locked pages stay resident, at most half of physical memory can be locked
+int vm_pager_lock(uint16_t v_index, int locked);
+int vm_pager_locked(uint16_t v_index);
+// count referenced bits of resident pages into heat
+void vm_pager_sample(uint16_t *heat);
+// lock the hottest pages, returns how many were locked
+uint32_t vm_pager_pin_hottest(const uint16_t *heat, uint32_t pages);
+
+void vm_pager_get_stats(vm_stats *stats);
+void vm_pager_clear_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
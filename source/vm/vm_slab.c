@@ -0,0 +1,84 @@
+/* 
+ * Copyright (c) 2015-2025, Extrems' Corner.org
+ * 
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include <stdlib.h>
+#include "vm_slab.h"
+
+#define LINK_NONE 0xFFFF
+
+static uint16_t *link;
+static uint16_t head[SLAB_CLASSES];
+static uint32_t top, granules, used;
+
+bool SlabInit(uint32_t size)
+{
+	granules = size / SLAB_GRANULE;
+	if (granules > LINK_NONE)
+		granules = LINK_NONE;
+	top = used = 0;
+
+	for (int class = 0; class < SLAB_CLASSES; class++)
+		head[class] = LINK_NONE;
+
+	free(link);
+	link = malloc(granules * sizeof(*link));
+	return link != NULL;
+}
+
+void SlabDeinit(void)
+{
+	free(link);
+	link = NULL;
+}
+
+uint32_t SlabAlloc(uint32_t length)
+{
+	int class = (length + SLAB_GRANULE - 1) / SLAB_GRANULE - 1;
+	uint32_t granule;
+
+	if (class < 0) class = 0;
+	if (class >= SLAB_CLASSES)
+		return SLAB_NONE;
+
+	if (head[class] != LINK_NONE) {
+		granule = head[class];
+		head[class] = link[granule];
+	} else if (top + class + 1 <= granules) {
+		granule = top;
+		top += class + 1;
+	} else {
+		// out of fresh space, settle for a bigger free slot
+		while (++class < SLAB_CLASSES && head[class] == LINK_NONE);
+		if (class == SLAB_CLASSES)
+			return SLAB_NONE;
+
+		granule = head[class];
+		head[class] = link[granule];
+	}
+
+	used += (class + 1) * SLAB_GRANULE;
+	return granule << 3 | class;
+}
+
+void SlabFree(uint32_t slot)
+{
+	uint32_t granule = slot >> 3;
+	int class = slot & 7;
+
+	if (slot == SLAB_NONE)
+		return;
+
+	link[granule] = head[class];
+	head[class] = granule;
+	used -= (class + 1) * SLAB_GRANULE;
+}
+
+uint32_t SlabUsed(void)
+{
+	return used;
+}
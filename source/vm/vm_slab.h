@@ -0,0 +1,29 @@
+/* 
+ * Copyright (c) 2015-2025, Extrems' Corner.org
+ * 
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef GBI_VM_SLAB_H
+#define GBI_VM_SLAB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SLAB_GRANULE 512
+#define SLAB_CLASSES (4096 / SLAB_GRANULE)
+#define SLAB_NONE    0xFFFFFFFF
+
+// slots are packed as granule << 3 | class, class n holds (n + 1) granules
+bool SlabInit(uint32_t size);
+void SlabDeinit(void);
+uint32_t SlabAlloc(uint32_t length);
+void SlabFree(uint32_t slot);
+uint32_t SlabUsed(void);
+
+#define SLAB_OFFSET(slot) (((slot) >> 3) * SLAB_GRANULE)
+#define SLAB_LENGTH(slot) ((((slot) & 7) + 1) * SLAB_GRANULE)
+
+#endif /* GBI_VM_SLAB_H */